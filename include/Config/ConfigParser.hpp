@@ -12,6 +12,8 @@
 #include <set>
 
 #include "SpecialResponse.hpp"
+#include "HTTPMethod.hpp"
+#include "sharedPtr.hpp"
 
 using namespace std;
 
@@ -24,6 +26,11 @@ class WebConfigFile
 private:
     std::ifstream _inputFile;
     vector<ServerConfig> _servers;
+    size_t _workerThreads;
+    size_t _workerProcesses;
+    size_t _maxConnections;
+    int _shutdownTimeout; // ms
+    size_t _bufferPoolSize; // bytes, 0 = no limit
 
 public:
     WebConfigFile(const string &fName);
@@ -34,6 +41,26 @@ public:
 
     void addServer(const ServerConfig &server);
 
+    size_t getWorkerThreads() const;
+
+    void setWorkerThreads(size_t n);
+
+    size_t getWorkerProcesses() const;
+
+    void setWorkerProcesses(size_t n);
+
+    size_t getMaxConnections() const;
+
+    void setMaxConnections(size_t n);
+
+    int getShutdownTimeout() const;
+
+    void setShutdownTimeout(int ms);
+
+    size_t getBufferPoolSize() const;
+
+    void setBufferPoolSize(size_t bytes);
+
     ~WebConfigFile();
 };
 
@@ -42,7 +69,15 @@ struct ServerConfig
     int port;
     string host;
     size_t maxBody;
-    int client_timeout;
+    int client_timeout; // ms
+    bool edgeTriggered;
+    size_t acceptBatch; // connections accepted per listener wakeup
+    size_t maxConnections; // open clients per event loop on this server, 0 = no limit
+    bool overloadReject;   // over the limit: accept and answer 503 instead of pausing the listener
+    int retryAfter;        // seconds, Retry-After of the overload 503
+    size_t headerBufferSize;      // bytes reserved for a request head up front
+    size_t largeHeaderBuffers;    // a longer head may use this many buffers of...
+    size_t largeHeaderBufferSize; // ...this size, a single line has to fit in one
     string name;
     string root;
     vector<string> indexFiles;
@@ -57,17 +92,21 @@ struct Location
     string route;
     string root;
     size_t maxBody;
-    int client_timeout;
+    int client_timeout; // ms
     bool autoindex;
     string cgi;
-    int cgi_timeout;
+    int cgi_timeout; // ms
     string upload;
     string redirect;
     vector<string> indexFiles;
-    vector<string> methods;
+    unsigned methods; // HttpMethod bits, HEAD comes with GET and OPTIONS is always answered
     string scriptInterpreter;
 
-    Location(ServerConfig server);
+    Location(const ServerConfig &server);
 };
 
+// immutable snapshot of a server block: a listener builds one per (re)configuration and
+// every handler it creates shares it, clients of an old snapshot keep it alive after a reload
+typedef sharedPtr<const ServerConfig> ServerConfigPtr;
+
 #endif
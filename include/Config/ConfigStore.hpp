@@ -0,0 +1,36 @@
+#ifndef CONFIG_STORE_HPP
+#define CONFIG_STORE_HPP
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "ConfigParser.hpp"
+
+// the running server configuration. SIGHUP only raises g_reload, the next
+// refresh() re-parses the file; event loops compare generations and hand the
+// new snapshot to their listeners, clients keep the config they started with
+class ConfigStore
+{
+private:
+    static std::string _path;
+    static std::vector<ServerConfig> _servers;
+    static unsigned _generation;
+    static pthread_mutex_t _lock;
+
+    // main-context values the process started with, a reload cannot change them
+    static size_t _workerThreads;
+    static size_t _workerProcesses;
+    static size_t _maxConnections;
+    static int _shutdownTimeout;
+    static size_t _bufferPoolSize;
+
+    static bool _sameListeners(const std::vector<ServerConfig> &servers);
+    static void _warnUnapplied(const WebConfigFile &config);
+
+public:
+    static void init(const std::string &path, WebConfigFile &config);
+    static unsigned refresh(); // re-parses if a reload is pending, returns the current generation
+    static std::vector<ServerConfig> snapshot();
+};
+
+#endif // CONFIG_STORE_HPP
@@ -7,7 +7,7 @@
 
 struct RouteMatch
 {
-    Location *location;
+    const Location *location;
     bool isMatched;
     bool methodAllowed;
     std::string normURI;
@@ -37,35 +37,35 @@ struct RouteMatch
 class Routing
 {
 private:
-    ServerConfig &_server;
+    ServerConfigPtr _server;
 
-    Location *_findLocation(const std::string &path);
+    const Location *_findLocation(const std::string &path);
     bool _matchesRoute(const std::string &path, const std::string &route);
 
-    std::string _resolvePath(Location &loc, const std::string &reqPath);
+    std::string _resolvePath(const Location &loc, const std::string &reqPath);
     std::string _cleanPath(const std::string &path);
     std::string _joinPath(const std::string &base, const std::string &path);
     std::string _getRelativePath(const std::string &path, const std::string &route);
 
-    bool _isCGI(Location &loc);
+    bool _isCGI(const Location &loc);
     void _splitCGIPath(const std::string &fsPath, std::string &scriptPath, std::string &pathInfo);
 
-    bool _isMethodAllowed(Location &loc, const std::string &method);
+    bool _isMethodAllowed(const Location &loc, HttpMethod method);
 
     bool _isPathExists(const std::string &path);
     bool _isDirectory(const std::string &path);
     bool _isFile(const std::string &path);
 
-    std::string _getRoot(Location &loc);
-    size_t _getMaxBodySize(Location &loc);
-    std::vector<std::string> _getIndexFiles(Location &loc);
+    std::string _getRoot(const Location &loc);
+    size_t _getMaxBodySize(const Location &loc);
+    std::vector<std::string> _getIndexFiles(const Location &loc);
 
 public:
-    Routing(ServerConfig &server);
+    Routing(const ServerConfigPtr &server);
 
-    RouteMatch match(const std::string &path, const std::string &method);
+    RouteMatch match(const std::string &path, HttpMethod method);
     std::string getErrorPage(int code);
-    std::string getAllowedMethodsStr(Location &loc);
+    std::string getAllowedMethodsStr(const Location &loc);
 };
 
 #endif
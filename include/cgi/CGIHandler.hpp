@@ -25,11 +25,14 @@
 #include <ctype.h>
 #include "../utils/Logger.hpp"
 #include <time.h>
-#define BUFFER_SIZE 4096
 
 // Helper function to convert int to string
 std::string intToString(int value);
 
+// buffered bytes at which the producing side of a CGI exchange is paused, and resumed again
+#define CGI_HIGH_WATER (256 * 1024)
+#define CGI_LOW_WATER (64 * 1024)
+
 class CGIHandler : public EventHandler
 {
 private:
@@ -44,20 +47,24 @@ private:
 	HTTPParser &_Reqparser;
 	HTTPParser _cgiParser;
 	HTTPResponse &_response;
+	EventHandler *_owner; // the client, resumed after every CGI event that may concern it
 	RouteMatch _match;
 	bool _isRunning;
 	bool _needBody;
+	bool _inputIdle;    // stdin is waiting for more request body
+	bool _outputPaused; // stdout is not read until the client catches up
+	bool _splicing;     // headers are out, the body goes pipe -> socket without being read
 
 	bool _ShouldAddSLine;
 
-	time_t expires_at;
-
 	//void init_(HTTPParser &parser, RouteMatch const &match);
 	void initEnv(HTTPParser &parser);
 	void initArgv(RouteMatch const &match);
+	void _closeInput();
+	void _pauseOutput();
 
 public:
-	CGIHandler(HTTPParser &parser, HTTPResponse &response, ServerConfig &config, FdManager &fdm);
+	CGIHandler(HTTPParser &parser, HTTPResponse &response, const ServerConfigPtr &config, FdManager &fdm, EventHandler *owner);
 	~CGIHandler();
 	int get_fd();
 	int getStatus();
@@ -69,6 +76,9 @@ public:
 	void onError();
 	void onTimeout();
 	bool isRunning() const;
+	void bodyAvailable();  // more request body was parsed
+	void outputDrained();  // the client sent part of the response
+	bool outputHandedOff() const; // stdout holds body bytes for the client to splice
 	void end();
 	void reset();
 };
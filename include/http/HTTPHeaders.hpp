@@ -0,0 +1,40 @@
+#ifndef WEBSERV_HTTPHEADERS_HPP
+#define WEBSERV_HTTPHEADERS_HPP
+
+#include <cstddef>
+
+// header names the server looks at (or that are common enough to be worth a slot).
+// The parser files each one under its id as it reads it, lookups by id are O(1)
+enum HeaderId
+{
+    HDR_UNKNOWN = -1,
+    HDR_HOST,
+    HDR_CONNECTION,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_TYPE,
+    HDR_TRANSFER_ENCODING,
+    HDR_EXPECT,
+    HDR_COOKIE,
+    HDR_USER_AGENT,
+    HDR_ACCEPT,
+    HDR_ACCEPT_ENCODING,
+    HDR_ACCEPT_LANGUAGE,
+    HDR_AUTHORIZATION,
+    HDR_REFERER,
+    HDR_RANGE,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_NONE_MATCH,
+    HDR_ORIGIN,
+    HDR_UPGRADE,
+    HDR_KEEP_ALIVE,
+    HDR_CACHE_CONTROL,
+    HDR_STATUS,     // CGI responses
+    HDR_LOCATION,   // CGI responses
+    HDR_COUNT
+};
+
+// case-insensitive name -> id through a perfect hash, HDR_UNKNOWN for anything else
+HeaderId headerId(const char *name, size_t len);
+const char *headerIdName(HeaderId id); // lowercase name
+
+#endif
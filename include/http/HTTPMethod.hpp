@@ -0,0 +1,30 @@
+#ifndef WEBSERV_HTTPMETHOD_HPP
+#define WEBSERV_HTTPMETHOD_HPP
+
+#include <cstddef>
+#include <string>
+
+// one bit per method, a location keeps the ones it allows as a mask
+enum HttpMethod
+{
+    METHOD_UNKNOWN = 0,
+    METHOD_GET = 1 << 0,
+    METHOD_HEAD = 1 << 1,
+    METHOD_POST = 1 << 2,
+    METHOD_PUT = 1 << 3,
+    METHOD_DELETE = 1 << 4,
+    METHOD_OPTIONS = 1 << 5
+};
+
+enum HttpVersion
+{
+    HTTP_UNKNOWN,
+    HTTP_10,
+    HTTP_11
+};
+
+HttpMethod methodFromName(const char *name, size_t len); // case-sensitive, METHOD_UNKNOWN if not served
+const char *methodName(HttpMethod method);
+std::string methodList(unsigned mask); // "GET, HEAD, ..." for an Allow header
+
+#endif
@@ -2,20 +2,27 @@
 #define WEBSERV_REQUEST_HPP
 
 #include <string>
-#include <map>
 #include <vector>
 #include <cstring>
 #include <algorithm>
 #include <stdexcept>
 
-#include "RingBuffer.hpp"
+#include "BufferChain.hpp"
+#include "StrView.hpp"
+#include "HTTPHeaders.hpp"
+#include "HTTPMethod.hpp"
 #include "multipart.hpp"
 
 #define CRLF        "\r\n"
 #define BUFF_SIZE   8192    // 8kb
 #define NPOS        std::string::npos
+#define HEADERS_RESERVE 32  // header slots reserved up front, typical requests never grow it
+
+// request head limits, the defaults of client_header_buffer_size / large_client_header_buffers
+#define HEADER_BUFFER_SIZE  1024
+#define LARGE_HEADER_COUNT  4
+#define LARGE_HEADER_SIZE   8192
 
-typedef std::map<std::string, std::string> strmap;
 typedef void (*bodyHandler)(const char* buff, size_t size, void *data);
 
 enum parse_state
@@ -63,10 +70,25 @@ class HTTPParser
     std::string _query;
     std::string _fragment;
     std::string _version;
-    strmap      _headers;
+    HttpMethod  _methodId;  // METHOD_UNKNOWN for a method we do not serve
+    HttpVersion _versionId;
+
+    // header fields as offsets into _buffer, the head stays at the front of the
+    // buffer until reset() so the views remain valid while the body streams in
+    struct HeaderField
+    {
+        size_t name;
+        size_t nameLen;
+        size_t value;
+        size_t valueLen;
+        HeaderId id;
+    };
+    std::vector<HeaderField> _fields;
+    size_t      _known[HDR_COUNT]; // 1 + index in _fields of the first field of each known name, 0 if absent
+    size_t      _headEnd;   // end of the request head in _buffer, 0 while it is parsed
 
     // the requst body (default for now)
-    RingBuffer  _body;
+    BufferChain _body;
     size_t      _contentLength;
     size_t      _bytesRead;
 
@@ -76,7 +98,7 @@ class HTTPParser
 
     bool        _isMultiPart;
     std::string _boundary;
-    Multipart   _MultiParser;
+    Multipart   *_MultiParser; // created once a multipart/form-data body is announced
 
     bodyHandler _bodyHandler;
     void        *_data;
@@ -91,10 +113,22 @@ class HTTPParser
     std::string _buffer;
     size_t      _buffOffset;
 
+    // where the scan for the current line stopped, so bytes are only looked at once
+    // however the head is split across recv calls. 0 when a new line starts
+    size_t      _scanPos;
+    size_t      _colonPos;  // colon of the header line being scanned, NPOS before it is seen
+
+    size_t      _lineMax;   // longest request or header line
+    size_t      _headMax;   // longest request head
+    int         _errorStatus; // response status once the state is ERROR
+
     // this is the size of the request body
     // can be used with 'client_max_body_size'
     size_t  _bodySize;
 
+    size_t  _lineEnd(size_t from);
+    void    _checkHeadSize();
+    void    _fail(int status);
     void    _decodeURI();
     void    _parseChunkedSize();
     void    _parseChunkedSegment();
@@ -104,8 +138,12 @@ class HTTPParser
     void    _parseStartLine();
     void    _parse();
 
+    HTTPParser(const HTTPParser& other);
+    HTTPParser& operator=(const HTTPParser& other);
+
 public:
     HTTPParser();
+    ~HTTPParser();
 
     // for the following funcitons, if an attribute like 'method' is not ready,
     // an empty string will be returned
@@ -114,22 +152,33 @@ public:
     std::string&    getQuery(void);
     std::string&    getFragment(void);
     std::string&    getVers(void);
-
-    strmap&         getHeaders(void);
-    std::string&    getHeader(const std::string& key);
+    HttpMethod      getMethodId(void) const;
+    HttpVersion     getVersionId(void) const;
+
+    // header views point into the receive buffer: they stay valid until the next
+    // addChunk() or reset(). names keep their original case, lookups ignore it
+    size_t          headerCount(void) const;
+    StrView         headerName(size_t i) const;
+    StrView         headerValue(size_t i) const;
+    HeaderId        headerId(size_t i) const;
+    StrView         getHeader(HeaderId id) const;
+    StrView         getHeader(const char *key) const; // key in lowercase, empty view if missing
 
     void    setBodyHandler(bodyHandler bh, void *data);
     void    setUploadDir(const std::string& dir);
     
+    // initial buffer size, longest line and longest head
+    void    setHeaderLimits(size_t bufferSize, size_t lineMax, size_t headMax);
     void    setCGIMode(bool m);
     bool    getCGIMode(void);
 
     parse_state     getState();
     bool            isComplete();
     bool            isError();
+    int             getErrorStatus(); // 400, 414/431 for a head over the limits, 505 for another HTTP version
     bool            isMultiPart();
 
-    RingBuffer& getBody(void);
+    BufferChain& getBody(void);
     bool        hasBody(void);
     size_t      getBodySize(void);
 
@@ -0,0 +1,34 @@
+#ifndef WEBSERV_HTTPSCAN_HPP
+#define WEBSERV_HTTPSCAN_HPP
+
+#include <cstddef>
+
+// delimiter and token scans used by the request parser. On x86 the kernels run 32
+// (AVX2) or 16 (SSE2) bytes per step, picked from cpuid on the first call, other
+// targets use the scalar loops. The pick is not thread safe, so main() makes the
+// first call through kernel() before any worker thread starts.
+class HTTPScan
+{
+private:
+    typedef size_t (*findKernel)(const char *p, size_t len, char a, char b);
+    typedef size_t (*tokenKernel)(const char *p, size_t len);
+
+    static findKernel _find;
+    static tokenKernel _token;
+
+    static void _select();
+    static size_t _findFirst(const char *p, size_t len, char a, char b);
+    static size_t _tokenFirst(const char *p, size_t len);
+
+    HTTPScan();
+
+public:
+    // index of the first byte equal to a or b, len if there is none
+    static size_t find(const char *p, size_t len, char a, char b) { return _find(p, len, a, b); }
+    // true if every byte is an RFC 9110 tchar, used for methods and header names
+    static bool isToken(const char *p, size_t len) { return len && _token(p, len) == len; }
+    static bool isTchar(unsigned char c);
+    static const char *kernel(); // "avx2", "sse2" or "scalar"
+};
+
+#endif
@@ -10,9 +10,6 @@
 #include "SpecialResponse.hpp"
 #include "../cgi/CGIHandler.hpp"
 
-// the current methods we are required to handle
-// static const char* methods[] = { "GET", "POST", "DELETE" };
-
 class RequestHandler
 {
     Logger  logger;
@@ -21,22 +18,32 @@ class RequestHandler
     HTTPParser      &_request;
     HTTPResponse    &_response;
 
-    CGIHandler      _cgi;
+    ServerConfigPtr _config;
+    FdManager       &_fdManager;
+    CGIHandler      *_cgi;  // only allocated for requests routed to a CGI script
+    EventHandler    *_owner; // the client, resumed by the CGI once it drained the body
 	time_t			_cgiSrtartTime;
 
     bool            _keepAlive;
     bool            _isCGI;
     bool            _isDirSet;
 
+    // PUT: the body goes to a temporary file next to the target, renamed over it once complete
+    int             _putFd;
+    std::string     _putTemp;
+    bool            _putCreated;
+
     void    _common(const RouteMatch& match);
     // i wanted to use an iteface for this, but it's overkill
     void    _handleGET(const RouteMatch& match);
     void    _handlePOST(const RouteMatch& match);
     void    _handleDELETE(const RouteMatch& match);
-    void    _handleOPTIONS();
+    void    _handlePUT(const RouteMatch& match);
+    void    _handleOPTIONS(const RouteMatch& match);
+    void    _abortPUT();
 
     // helper methods
-    void        _sendErrorResponse(int code);
+    void        _sendErrorResponse(int code, const Location *allow = NULL); // a 405 lists the location's methods
     void        _serveFile(const RouteMatch& path);
     void        _serveDict(const RouteMatch& match);
     std::string _getDictListing(const std::string& path);
@@ -59,8 +66,11 @@ class RequestHandler
         }
     };
 
+    RequestHandler(const RequestHandler& other);
+    RequestHandler& operator=(const RequestHandler& other);
+
 public:
-    RequestHandler(ServerConfig &config, HTTPParser& req, HTTPResponse& resp, FdManager &fdManager);
+    RequestHandler(const ServerConfigPtr &config, HTTPParser& req, HTTPResponse& resp, FdManager &fdManager, EventHandler *owner);
     ~RequestHandler();
 
     void    feed(char* buff, size_t size);
@@ -70,6 +80,11 @@ public:
 
     bool    isResComplete();
     bool    isError();
+    bool    inputThrottled();
+    bool    inputDrained();
+    bool    responsePending();
+    size_t  responseUnsent();
+    void    outputDrained();
     bool    keepAlive();
     bool    responseStarted;
 
@@ -77,7 +92,7 @@ public:
 
     // return true if response is ready to be sent
     bool    processRequest();
-    size_t  readNextChunk(char* buff, size_t size);
+    ssize_t sendTo(int fd);
 
     void    reset();
 };
@@ -10,24 +10,36 @@
 #include <cstring>
 #include <sstream>
 #include "Routing.hpp"
-#include "RingBuffer.hpp"
+#include "BufferChain.hpp"
 
 // helper macro to stringify values
 #define SSTR(x) static_cast<std::ostringstream &>((std::ostringstream() << x)).str()
 
 #define BUFF_SIZE 8192 // 8 KB buffer
+#define SEND_WINDOW (CHAIN_SEGMENT * 4) // file bytes queued behind the headers per writev
+#define SENDFILE_CHUNK (256 * 1024)     // file bytes handed to one sendfile, larger files than SEND_WINDOW
 #define CRLF "\r\n"
 
 class HTTPResponse
 {
     std::string _version;
-    RingBuffer  _response;   // headers + optional small body
+    BufferChain _response;   // headers + optional small body, grows instead of overwriting
 
     int     _file_fd;       // file descriptor (if serving file)
     size_t  _file_size;     // total file size
-    size_t  _bytes_sent;    // bytes sent from file
+    size_t  _file_offset;   // bytes of the file already queued in _response or sent
+    bool    _sendfile;      // the file goes from the page cache to the socket, not through _response
+    bool    _corked;        // TCP_CORK holds the headers back until the first file bytes join them
+    int     _pipe_fd;       // CGI stdout spliced to the socket as chunks, -1 when the body is buffered
+    size_t  _chunkLeft;     // bytes of the current spliced chunk still in the pipe
+    bool    _headOnly;      // HEAD: headers describe the body, the body itself is dropped
     
     
+    bool    _fillFromFile();
+    ssize_t _sendFile(int fd);
+    ssize_t _sendPipe(int fd);
+    void    _appendChunkSize(size_t size);
+    void    _cork(int fd, bool on);
     const std::string _getContentType(const std::string &filepath);
     const std::string _getStatus(int code);
     public:
@@ -36,6 +48,8 @@ class HTTPResponse
     ~HTTPResponse();
     
     void    startLine(int code);
+    void    setHeadOnly(bool on); // kept across reset(), an error page for HEAD has no body either
+    bool    isHeadOnly() const;
 
     void addHeader(const std::string &name, const std::string &value);
     void endHeaders();
@@ -48,18 +62,27 @@ class HTTPResponse
     // used for chunked transfer (chunked transfer needs to be added in the headers)
     void feedRAW(const char* data, size_t size);
     void feedRAW(const std::string& data);
+    void feedRAW(BufferChain& data); // moves the segments of data into one chunk, no copy
+    // from now on the body is spliced from this pipe to the socket, one chunk per pipe-full.
+    // -1 stops it, the owner must do so before closing the pipe or adding the last chunk
+    void spliceFrom(int pipe_fd);
 
     // serve file as body (sets Content-Length automatically)
     // this behavoir might change if we plan to support 'chunekd transfer'
     bool attachFile(const std::string &filepath);
     void closeFile();
 
-    // write next chunk of data into buffer
-    ssize_t readNextChunk(char *buffer, size_t buffer_size);
+    // writes the queued headers and body to fd with one writev, the file body is read in
+    // behind them so a small file goes out in the same call. Unsent bytes stay queued.
+    // returns the bytes written, 0 when nothing is queued, -1 with errno
+    ssize_t sendTo(int fd);
 
     // true if headers + file are fully sent
     bool isComplete() const;
 
+    size_t pending() const; // bytes buffered and not handed to the client yet
+    size_t unsent() const;  // pending() plus the part of the file not read or sent yet
+
     void reset();
 };
 
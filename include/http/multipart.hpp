@@ -6,7 +6,7 @@
 #include <fstream>
 #include <algorithm>
 
-#include "RingBuffer.hpp"
+#include "BufferChain.hpp"
 #include "Logger.hpp"
 
 #define CRLF "\r\n"
@@ -30,13 +30,13 @@ public:
         std::string filename;
 
         // just normal forms
-        RingBuffer body;
+        BufferChain body;
 
         // file stuff
         std::string     filePath;
         bool            isfile;
 
-        formData(): body(BUFSIZ), isfile(false) {}
+        formData(): isfile(false) {}
     };
     typedef std::vector<formData> parts_t;
 
@@ -50,7 +50,7 @@ private:
     std::string     _str_boundry;
     std::string     _uploadDict;
 
-    RingBuffer&     _buff;
+    BufferChain&    _buff;
     std::ofstream   _outfile;
 
     parts_t     _parts; // a vector of paths
@@ -71,7 +71,7 @@ private:
 
 public:
     // i will inject the buffer
-    Multipart(RingBuffer& body);
+    Multipart(BufferChain& body);
     ~Multipart();
     
     void    setUploadPath(const std::string& path);
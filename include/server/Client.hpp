@@ -1,8 +1,6 @@
 #ifndef WEBSERV_CLIENT_HPP
 #define WEBSERV_CLIENT_HPP
 
-#define DEFAULT_CLIENT_TIMEOUT 7
-
 #include "EventHandler.hpp"
 #include "FdManager.hpp"
 #include "Socket.hpp"
@@ -11,8 +9,12 @@
 #include "ConfigParser.hpp"
 #include "Logger.hpp"
 #include "RequestHandler.hpp"
+#include "sharedPtr.hpp"
 #include <time.h>
 
+// bytes a single wakeup may move in edge-triggered mode before yielding to other clients
+#define ET_IO_BUDGET (BUFF_SIZE * 32)
+
 enum ClientState
 {
     ST_READING,
@@ -24,23 +26,41 @@ enum ClientState
     ST_ERROR
 };
 
+// everything one request/response needs; allocated when the first byte of a request
+// arrives and freed once its response is sent, so an idle connection does not carry it
+struct Transaction
+{
+    HTTPParser req;
+    HTTPResponse resp;
+    RequestHandler handler;
+
+    Transaction(const ServerConfigPtr &config, FdManager &fdm, EventHandler *owner);
+};
+
 class Client : public EventHandler
 {
+    std::string _strFD; // before _socket: once _socket owns the fd the constructor cannot throw
     Socket _socket;
     Logger logger;
 
-    HTTPParser _req;
-    HTTPResponse _resp;
+    Transaction *_tx; // NULL between requests
 
-    RequestHandler _handler;
-
-    char _readBuff[BUFF_SIZE];
-    char _sendBuff[BUFF_SIZE];
-
-    std::string _strFD;
     ClientState _state;
 
     bool _keepAlive;
+    bool _idle; // between two keep-alive requests, a fresh connection still gets its first one served
+
+    bool _edgeTriggered;
+    bool _wouldBlock; // the last recv/send hit EAGAIN, the next edge will wake us
+    bool _inputPaused; // the CGI has not caught up with the request body yet
+    size_t _ioBytes;  // bytes moved during the current wakeup
+    unsigned long long _bytesSent; // over the whole connection
+
+    sharedPtr<ConnectionStats> _serverConnections; // shared with the accepting Server, may outlive it
+
+    uint32_t _mask(uint32_t events);
+    uint32_t _processingMask();
+    RequestHandler &_handler();
 
     bool _shouldKeepAlive();
 
@@ -53,7 +73,7 @@ class Client : public EventHandler
     bool _sendData();
 
 public:
-    Client(int socket_fd, ServerConfig &config, FdManager &fdm);
+    Client(int socket_fd, const ServerConfigPtr &config, FdManager &fdm, const sharedPtr<ConnectionStats> &serverConnections);
     ~Client();
 
     void reset();
@@ -67,6 +87,8 @@ public:
     void onWritable();
     void onError();
     void onTimeout();
+    void onDrain();
+    void resume();
     int get_fd();
 };
 
@@ -5,23 +5,11 @@
 #include <unistd.h>
 #include <stdexcept>
 #include <vector>
+#include <stdint.h>
 #include "Socket.hpp"
+#include "Poller.hpp"
 
-#define TIMEOUT_EVENT (1 << 5)
-#define IS_TIMEOUT_EVENT(event) ((event) & TIMEOUT_EVENT)
-#define IS_READ_EVENT(event) ((event) & EPOLLIN)
-#define IS_WRITE_EVENT(event) ((event) & EPOLLOUT)
-#define IS_ERROR_EVENT(event) ((event) & (EPOLLERR | EPOLLHUP))
-#define EDGE_TRIGGERED_EVENT(event) ((event) & EPOLLET)
-#define ONE_SHOT_EVENT(event) ((event) & EPOLLONESHOT)
-#define PRIORITY_EVENT(event) ((event) & EPOLLPRI)
-#define READ_WRITE_EVENT (EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP)
-#define READ_EVENT (EPOLLIN | EPOLLERR | EPOLLHUP)
-#define WRITE_EVENT (EPOLLOUT | EPOLLERR | EPOLLHUP)
-
-#define MAX_EVENTS 1024
-
-class Epoll
+class Epoll : public Poller
 {
 private:
     int _epoll_fd;
@@ -32,12 +20,13 @@ public:
     Epoll();
     ~Epoll();
     void add_fd(Socket &socket, uint32_t events = EPOLLIN);
-    void add_fd(int fd, uint32_t events = EPOLLIN);
-    void modify_fd(int fd, uint32_t events);
+    void add_fd(int fd, uint32_t events, uint32_t generation);
+    void modify_fd(int fd, uint32_t events, uint32_t generation);
     void remove_fd(int fd);
     void remove_fd(Socket &socket);
     void modify_fd(Socket &socket, uint32_t events);
-    std::vector<epoll_event> wait(int timeout = -1);
+    EventSpan wait(int timeout = -1);
+    const char *name() const;
     int getFd();
 };
 
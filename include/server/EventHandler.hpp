@@ -3,6 +3,8 @@
 
 #include "../Config/ConfigParser.hpp"
 #include "Socket.hpp"
+#include "Timer.hpp"
+#include <cassert>
 
 class FdManager;
 
@@ -10,12 +12,14 @@ class EventHandler
 {
 protected:
     FdManager &_fd_manager;
-    ServerConfig _config;
-    time_t _expiresAt;
-    virtual void _updateExpiresAt(time_t new_expires) { _expiresAt = new_expires; };
+    ServerConfigPtr _config;
+    msec_t _expiresAt;
+    // deadlines only ever move forward: the timer heap re-checks an entry when it reaches the top,
+    // so an earlier deadline would go unnoticed until the stale one expires
+    virtual void _updateExpiresAt(msec_t new_expires) { assert(new_expires >= _expiresAt); _expiresAt = new_expires; };
 
 public:
-    EventHandler(ServerConfig &config, FdManager &fdm, time_t expires_at);
+    EventHandler(const ServerConfigPtr &config, FdManager &fdm, msec_t expires_at);
     virtual ~EventHandler() {}
     virtual void onEvent(uint32_t events) = 0;
     virtual void destroy() { // evey handler implement it's own destroy
@@ -26,9 +30,12 @@ public:
     virtual void onWritable() {};
     virtual void onError() {};
     virtual void onTimeout() {};
-    virtual time_t getExpiresAt() const { return _expiresAt; };
+    virtual void onDrain() {}; // graceful shutdown started
+    virtual void resume() {}; // a peer this handler paused for caught up
+    virtual void reconfigure(const std::vector<ServerConfig> &servers) { (void)servers; }; // config reloaded
+    virtual msec_t getExpiresAt() const { return _expiresAt; };
 };
 
-inline EventHandler::EventHandler(ServerConfig &config, FdManager &fdm, time_t expires_at) : _fd_manager(fdm), _config(config), _expiresAt(expires_at) {}
+inline EventHandler::EventHandler(const ServerConfigPtr &config, FdManager &fdm, msec_t expires_at) : _fd_manager(fdm), _config(config), _expiresAt(expires_at) {}
 
 #endif // EVENT_HANDLER_HPP
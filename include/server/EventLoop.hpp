@@ -1,23 +1,43 @@
 #ifndef EVENT_LOOP_HPP
 #define EVENT_LOOP_HPP
 
-#include "Epoll.hpp"
+#include "Poller.hpp"
 #include "FdManager.hpp"
+#include "Timer.hpp"
+#include "Waker.hpp"
 #include "Logger.hpp"
+#include "sharedPtr.hpp"
 
 class EventLoop
 {
 private:
-    Epoll epoll;
+    sharedPtr<Poller> poller; // declared before fd_manager so it outlives the handlers
+    Timer timer;
+    Waker &_waker;          // written by signal handlers and by the thread that owns the loop's Worker
     Logger logger;
+    std::vector<int> _listeners;
+    unsigned _generation;   // ConfigStore generation the listeners run on
+    msec_t _drainDeadline;  // -1 until a graceful shutdown starts
+    bool _upgrades;         // this loop owns the process' listeners and answers SIGUSR2
+    static msec_t _shutdownTimeout;
+
+    void _reload();
+    void _startDrain();
+
+    EventLoop(const EventLoop &other);
+    EventLoop &operator=(const EventLoop &other);
 
 public:
     FdManager fd_manager;
-    EventLoop();
+    EventLoop(Waker &waker);
     ~EventLoop();
+    static void setShutdownTimeout(msec_t timeout);
+    void addListener(EventHandler *server);
+    void handleUpgrades();
     void run();
     void expireTimeouts();
-    int computeNextTimeout();
+    void armTimer();
+    void logStats();
 };
 
 #endif // EVENT_LOOP_HPP
\ No newline at end of file
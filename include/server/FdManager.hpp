@@ -1,30 +1,121 @@
 #ifndef FD_MANAGER_HPP
 #define FD_MANAGER_HPP
 
-#include <map>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <stdint.h>
 #include "EventHandler.hpp"
-#include "Epoll.hpp"
+#include "Poller.hpp"
 #include "../utils/Logger.hpp"
 std::string intToString(int value);
+
+#define IO_BUFFER_SIZE 8192 // size of the loop's shared recv/send scratch buffer
+
+// one pending deadline; handlers re-arm by moving their _expiresAt forward, the heap
+// entry is only corrected when it reaches the top (lazy deletion). Moving it earlier
+// is not supported, see EventHandler::_updateExpiresAt
+struct TimerEntry
+{
+    msec_t expires;
+    int fd;
+    uint32_t generation; // a stale entry no longer matches the fd's slot
+
+    bool operator>(const TimerEntry &other) const { return expires > other.expires; }
+};
+
+typedef std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry> > TimerHeap;
+
+// open client connections against a max_connections limit (0 = no limit)
+struct ConnectionStats
+{
+    size_t current;
+    size_t peak;
+    unsigned long shed; // connections answered 503 because of the limit
+    size_t max;
+
+    bool full() const { return max && current >= max; }
+    void opened() { if (++current > peak) peak = current; }
+};
+
+// what the loop's clients wrote. A response is queued in full and written as the socket
+// takes it, so every queued byte ends up either sent or dropped with its connection
+struct OutboundStats
+{
+    unsigned long long sent;    // bytes the client sockets accepted
+    unsigned long writes;       // send calls that wrote something
+    unsigned long blocked;      // send calls that found the socket full with bytes still queued
+    unsigned long long dropped; // queued bytes of responses whose connection closed first
+};
+
 class FdManager
 {
 private:
-    Epoll &_epoll;
-    std::map<int, EventHandler *> fd_map;
-    std::map<int, EventHandler *> timeout_map;
+    // everything the loop needs to know about an fd, indexed directly by the fd
+    struct FdSlot
+    {
+        EventHandler *handler; // NULL when the fd is not registered
+        uint32_t events;       // current epoll interest mask
+        uint32_t generation;   // bumped on every registration, tags epoll events and timers
+        bool timeout;          // takes part in deadline expiry
+    };
+
+    Poller &_poller;
+    std::vector<FdSlot> _slots;
+    size_t _maxFds;
+    size_t _registered;
+    bool _draining;
+    TimerHeap _timers;
+
+    ConnectionStats _connections;                            // every client of this loop
+    OutboundStats _outbound;
+    // a paused listener and the mask to restore; the generation tells whether the fd still is that listener
+    struct PausedListener
+    {
+        int fd;
+        uint32_t events;
+        uint32_t generation;
+    };
+
+    std::vector<PausedListener> _pausedListeners;
+    bool _resumeListeners;
+    static size_t _connectionLimit;
+    std::vector<char> _ioBuffer; // recv scratch shared by the loop's clients and CGI pipes
+
+    FdSlot *_slot(int fd);
 
 public:
-    FdManager(Epoll &epoll);
+    FdManager(Poller &poller);
     ~FdManager();
     void add(int fd, EventHandler *handler, int events, bool timeout = true);
     void remove(int fd);
     void detachFd(int fd);
 
     EventHandler *getOwner(int fd);
+    EventHandler *getOwner(int fd, uint32_t generation);
     bool exists(int fd);
     void modify(int fd, uint32_t events);
     void modify(EventHandler *handler, uint32_t events);
-    std::map<int, EventHandler *> &getEventHandlersTimeouts();
+    void retrigger(int fd);
+    size_t size() const; // registered fds
+    char *ioBuffer();    // IO_BUFFER_SIZE bytes, only valid until the handler returns to the loop
+
+    void drain(); // graceful shutdown: tell every handler, keep-alive is off from now on
+    bool draining() const;
+
+    EventHandler *getTimerOwner(const TimerEntry &entry);
+    void popExpired(msec_t now, std::vector<TimerEntry> &expired);
+    void rearm(TimerEntry entry);
+    msec_t nextDeadline();
+
+    // global max_connections, set once from main before any loop is created
+    static void setConnectionLimit(size_t max);
+    ConnectionStats &connections();
+    OutboundStats &outbound();
+    void connectionOpened();
+    void connectionClosed();
+    void pauseListener(int fd); // stop polling a listener until a connection or another fd closes
+    void resumeListeners();     // called by the loop once per iteration
 };
 
-#endif // FD_MANAGER_HPP
\ No newline at end of file
+#endif // FD_MANAGER_HPP
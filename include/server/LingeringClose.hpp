@@ -0,0 +1,28 @@
+#ifndef LINGERING_CLOSE_HPP
+#define LINGERING_CLOSE_HPP
+
+#include "EventHandler.hpp"
+#include "FdManager.hpp"
+
+#define LINGER_TIMEOUT 2000 // ms a closing connection may keep sending before it is closed anyway
+
+// closes a connection whose write side is already shut down without resetting it: whatever
+// the peer still sends is read and dropped until it closes its side or LINGER_TIMEOUT passes.
+// A close() with unread bytes queued sends an RST, and the peer may drop the response with it
+class LingeringClose : public EventHandler
+{
+private:
+    Socket _socket;
+
+    LingeringClose(const LingeringClose &other);
+    LingeringClose &operator=(const LingeringClose &other);
+
+public:
+    LingeringClose(int fd, const ServerConfigPtr &config, FdManager &fdm);
+    static void start(int fd, const ServerConfigPtr &config, FdManager &fdm); // takes the fd in every case
+    int get_fd();
+    void destroy();
+    void onEvent(uint32_t events);
+};
+
+#endif // LINGERING_CLOSE_HPP
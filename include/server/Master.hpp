@@ -0,0 +1,40 @@
+#ifndef MASTER_HPP
+#define MASTER_HPP
+
+#include <sys/types.h>
+#include <csignal>
+#include <map>
+#include <vector>
+#include "Worker.hpp"
+
+// pre-fork supervisor: binds every listener once, forks the workers,
+// re-forks any worker that dies, forwards shutdown and reload signals to them
+// and hands the listeners to a new binary on SIGUSR2
+class Master
+{
+private:
+    std::vector<ServerConfig> &_servers;
+    size_t _nworkers;
+    std::vector<Socket *> _listeners;
+    std::map<pid_t, time_t> _workers; // pid -> spawn time
+    unsigned _generation;             // ConfigStore generation _servers comes from
+    Logger logger;
+
+    void _bindListeners();
+    pid_t _spawn(const sigset_t &childMask);
+    void _reap(const sigset_t &childMask);
+    void _reload();
+    void _signalWorkers(int signal);
+    void _upgrade();
+    void _stopWorkers();
+
+    Master(const Master &other);
+    Master &operator=(const Master &other);
+
+public:
+    Master(std::vector<ServerConfig> &servers, size_t nworkers);
+    ~Master();
+    void run();
+};
+
+#endif // MASTER_HPP
@@ -19,6 +19,7 @@ public:
     int write(const char *data, size_t size);
     int read_fd() const;
     int write_fd() const;
+    int available() const; // bytes waiting in the pipe (FIONREAD), 0 on error
     void set_non_blocking();
     void closeRead();
     void closeWrite();
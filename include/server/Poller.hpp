@@ -0,0 +1,82 @@
+#ifndef POLLER_HPP
+#define POLLER_HPP
+
+#include <sys/epoll.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#define TIMEOUT_EVENT (1 << 5)
+#define IS_TIMEOUT_EVENT(event) ((event) & TIMEOUT_EVENT)
+#define IS_READ_EVENT(event) ((event) & EPOLLIN)
+#define IS_WRITE_EVENT(event) ((event) & EPOLLOUT)
+#define IS_ERROR_EVENT(event) ((event) & (EPOLLERR | EPOLLHUP))
+#define EDGE_TRIGGERED_EVENT(event) ((event) & EPOLLET)
+#define ONE_SHOT_EVENT(event) ((event) & EPOLLONESHOT)
+#define PRIORITY_EVENT(event) ((event) & EPOLLPRI)
+#define READ_WRITE_EVENT (EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP)
+#define READ_EVENT (EPOLLIN | EPOLLERR | EPOLLHUP)
+#define WRITE_EVENT (EPOLLOUT | EPOLLERR | EPOLLHUP)
+
+#define INITIAL_EVENTS 256  // first size of the reusable event buffer
+#define MAX_EVENTS 65536     // the buffer doubles on full batches up to this size
+
+// epoll_event.data.u64 carries the fd in the low half and its FdManager generation in the high half
+#define EVENT_DATA(fd, gen) ((static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd))
+#define EVENT_FD(event) (static_cast<int>((event).data.u64 & 0xffffffffu))
+#define EVENT_GEN(event) (static_cast<uint32_t>((event).data.u64 >> 32))
+
+// view over the events returned by the last wait(), valid until the next wait()
+struct EventSpan
+{
+    epoll_event *first;
+    epoll_event *last;
+
+    epoll_event *begin() const { return first; }
+    epoll_event *end() const { return last; }
+    size_t size() const { return last - first; }
+};
+
+// per-loop counters to tune the buffer size and see how busy wakeups are
+struct PollerStats
+{
+    unsigned long wakeups;     // waits that returned events
+    unsigned long events;      // events returned in total
+    unsigned long fullBatches; // batches that filled the whole buffer
+    size_t maxBatch;           // largest single batch
+    size_t capacity;           // current buffer size
+};
+
+// readiness backend of an EventLoop. Every backend reports events as epoll_event
+// records (epoll flag values, EVENT_DATA tags) so handlers do not care which one runs.
+class Poller
+{
+protected:
+    std::vector<epoll_event> _events;
+    bool _lastBatchFull;
+    PollerStats _stats;
+
+    epoll_event *_beginBatch();
+    void _endBatch(size_t count);
+
+private:
+    Poller(const Poller &other);
+    Poller &operator=(const Poller &other);
+
+public:
+    Poller();
+    virtual ~Poller();
+
+    virtual void add_fd(int fd, uint32_t events, uint32_t generation) = 0;
+    virtual void modify_fd(int fd, uint32_t events, uint32_t generation) = 0;
+    virtual void remove_fd(int fd) = 0;
+    // timeout is -1 (block) or 0 (poll), deadlines are handled by the loop's timerfd
+    virtual EventSpan wait(int timeout = -1) = 0;
+    virtual const char *name() const = 0;
+    const PollerStats &getStats() const;
+
+    static Poller *create();
+};
+
+#endif // POLLER_HPP
@@ -3,15 +3,36 @@
 
 #include "EventHandler.hpp"
 #include "Socket.hpp"
+#include "FdManager.hpp"
+#include "sharedPtr.hpp"
 #include "../Config/ConfigParser.hpp"
 
 class Server : public EventHandler
 {
 private:
     Socket _socket;
+    int _reserveFd; // spare descriptor given up to shed a connection when the fd table is full
+
+    // accept statistics, logged when the listener goes away
+    unsigned long _accepted;
+    unsigned long _shed;
+    size_t _maxBatch;
+    unsigned _peakQueue;
+    unsigned long _pauses;
+
+    sharedPtr<ConnectionStats> _connections; // clients of this server, against max_connections
+    std::string _overloadResponse;           // prebuilt 503 for overload_policy reject
+
+    void _init();
+    void _buildOverloadResponse();
+    bool _shedConnection();
+    void _rejectOverload(int fd);
+    void _sampleQueue();
 
 public:
-    Server(ServerConfig &config, FdManager &fdm);
+    Server(const ServerConfig &config, FdManager &fdm, bool reusePort = false);
+    Server(const ServerConfig &config, FdManager &fdm, int fd, fromFdTag); // adopt an already listening socket
+    static void listenOn(Socket &socket, const ServerConfig &config, bool reusePort);
     ~Server();
     int get_fd() const;
     void destroy();
@@ -20,6 +41,7 @@ public:
     void onWritable();
     void onError();
     void onTimeout();
+    void reconfigure(const std::vector<ServerConfig> &servers);
     int get_fd();
 };
 
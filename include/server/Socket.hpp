@@ -35,7 +35,7 @@ public:
     void bind(struct sockaddr_in address);
     void listen();
     void set_non_blocking();
-    int accept();
+    int accept(int flags = 0); // accept4(), -1 with errno set when nothing could be accepted
     void connect(std::string ip, int port);
     void connect(struct sockaddr_in address);
     void connect(std::string ip, int port, sa_family_t family);
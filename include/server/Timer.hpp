@@ -0,0 +1,30 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdexcept>
+
+// milliseconds on CLOCK_MONOTONIC, used for every handler deadline
+typedef long long msec_t;
+
+// timerfd armed on the earliest pending deadline, epoll reports it readable when that deadline passes
+class Timer
+{
+private:
+    int _fd;
+    msec_t _armedAt;
+    Timer(const Timer &other);
+    Timer &operator=(const Timer &other);
+
+public:
+    Timer();
+    ~Timer();
+    static msec_t now();
+    int getFd() const;
+    void arm(msec_t deadline); // absolute deadline, -1 disarms
+    void clear();              // consume the expiration after a wakeup
+};
+
+#endif // TIMER_HPP
@@ -0,0 +1,31 @@
+#ifndef UPGRADE_HPP
+#define UPGRADE_HPP
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#define LISTEN_FDS_ENV "WEBSERV_LISTEN_FDS"         // "3,4": listening sockets handed to a new binary
+#define UPGRADE_PARENT_ENV "WEBSERV_UPGRADE_PARENT" // pid of the instance that started us
+
+// zero-downtime binary upgrade (SIGUSR2): the running instance fork+execs the
+// binary again with its listening sockets left open and listed in the environment.
+// The new instance adopts the sockets that match its config instead of binding,
+// and once it serves it sends SIGTERM to the old one, which drains and exits.
+class Upgrade
+{
+private:
+    static std::string _binary;
+    static std::string _config;
+    static std::vector<int> _inherited;
+    static pid_t _parent;
+    static pid_t _child;
+
+public:
+    static void init(const char *binary, const char *config); // also picks up inherited sockets
+    static int take(const std::string &host, int port);       // inherited listener for host:port, or -1
+    static void ready();                                      // close unclaimed sockets, retire the old instance
+    static pid_t spawn(const std::vector<int> &listenFds);
+};
+
+#endif // UPGRADE_HPP
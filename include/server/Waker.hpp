@@ -0,0 +1,26 @@
+#ifndef WAKER_HPP
+#define WAKER_HPP
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <stdexcept>
+
+// eventfd kept in the loop's poll set. Signal handlers and other threads write to it,
+// so a flag set between the loop's checks and its wait still ends that wait
+class Waker
+{
+private:
+    int _fd;
+    Waker(const Waker &other);
+    Waker &operator=(const Waker &other);
+
+public:
+    Waker();
+    ~Waker();
+    int getFd() const;
+    void wake();  // async-signal-safe
+    void clear(); // consume the wakeups after the loop saw the fd readable
+    static void wake(int fd);
+};
+
+#endif // WAKER_HPP
@@ -0,0 +1,42 @@
+#ifndef WORKER_HPP
+#define WORKER_HPP
+
+#include <pthread.h>
+#include <csignal>
+#include <vector>
+#include "EventLoop.hpp"
+#include "Server.hpp"
+#include "../Config/ConfigParser.hpp"
+
+// one reactor: its own EventLoop/Epoll/FdManager and its own copy of every listener,
+// clients accepted by a worker never leave it
+class Worker
+{
+private:
+    std::vector<ServerConfig> &_servers;
+    std::vector<int> _listenFds; // listeners bound by the master, one per server (process mode)
+    bool _reusePort;
+    pthread_t _thread;
+    bool _started;
+    bool _done;             // set by the worker thread when run() returns, guarded by _doneLock
+    pthread_mutex_t _doneLock;
+    Waker _waker;           // ends the loop's wait, see wake()
+    Logger logger;
+
+    static void *_routine(void *arg);
+    bool _isDone();
+
+    Worker(const Worker &other);
+    Worker &operator=(const Worker &other);
+
+public:
+    Worker(std::vector<ServerConfig> &servers, bool reusePort);
+    Worker(std::vector<ServerConfig> &servers, const std::vector<int> &listenFds);
+    ~Worker();
+    void run();
+    void start();
+    void wake(); // interrupt the loop's wait so it checks its flags
+    void stop();
+};
+
+#endif // WORKER_HPP
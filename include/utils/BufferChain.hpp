@@ -0,0 +1,54 @@
+#ifndef WEBSERV_BUFFERCHAIN_HPP
+#define WEBSERV_BUFFERCHAIN_HPP
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <deque>
+#include <string>
+
+#define CHAIN_SEGMENT 16384 // BufferPool page size of one segment
+#define CHAIN_IOV_MAX 64    // segments handed to one readv/writev
+
+// byte queue made of pooled segments: it grows instead of overwriting, appends fill the
+// last segment before borrowing a new page, consumed segments go straight back to the pool
+// and splice() moves whole segments between chains without copying the bytes
+class BufferChain
+{
+private:
+    struct Segment
+    {
+        char *data;
+        size_t start; // first unread byte
+        size_t end;   // one past the last written byte
+    };
+
+    std::deque<Segment> _segments;
+    size_t _size;
+
+    Segment &_writable(); // last segment if it has room, a fresh one otherwise
+    void _pop();
+
+public:
+    BufferChain();
+    BufferChain(const BufferChain &other);
+    BufferChain &operator=(const BufferChain &other);
+    ~BufferChain();
+
+    size_t size() const;
+    bool empty() const;
+
+    void append(const char *data, size_t size);
+    void append(const std::string &data);
+    void splice(BufferChain &other); // moves all of other to the end of this chain
+
+    size_t peek(char *out, size_t size) const; // copies without consuming
+    size_t read(char *out, size_t size);       // copies and consumes
+    void consume(size_t size);
+    void clear();
+
+    size_t exportIov(struct iovec *iov, size_t max) const; // readable bytes, in order
+    ssize_t writeTo(int fd);                // writev() as much as the fd takes, -1 with errno
+    ssize_t readFrom(int fd, size_t max);   // readv() into the tail, -1 with errno
+};
+
+#endif
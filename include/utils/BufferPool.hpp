@@ -0,0 +1,48 @@
+#ifndef WEBSERV_BUFFERPOOL_HPP
+#define WEBSERV_BUFFERPOOL_HPP
+
+#include <pthread.h>
+#include <cstddef>
+#include <vector>
+
+#define POOL_MIN_PAGE 4096 // smallest size class
+#define POOL_CLASSES 6     // 4, 8, 16, 32, 64 and 128 KB pages
+
+struct PoolStats
+{
+    size_t budget;           // 0 = no limit
+    size_t allocated;        // bytes held by the pool: pages in use plus cached free pages
+    size_t inUse;            // bytes lent out right now
+    size_t highWater;        // largest inUse seen
+    unsigned long borrows;   // acquire() calls
+    unsigned long reused;    // borrows served from a free list
+    unsigned long failures;  // borrows refused because of the budget
+};
+
+// process-wide pool of fixed-size pages for I/O buffers. Pages are borrowed while
+// a buffer holds data and handed back once it is drained; freed pages are kept
+// (last in, first out, so the next borrower gets a cache-warm one) and only given
+// back to malloc when another size class needs room under the budget.
+class BufferPool
+{
+private:
+    static std::vector<char *> _free[POOL_CLASSES];
+    static PoolStats _stats;
+    static pthread_mutex_t _lock;
+
+    static int _class(size_t size); // -1 above the largest class
+    static bool _reserve(size_t size);
+
+    BufferPool();
+
+public:
+    static void setBudget(size_t bytes); // set once from main, 0 = no limit
+    static size_t pageSize(size_t size);  // size rounded up to its class
+    static char *acquire(size_t size);     // NULL when the budget is exhausted
+    static void release(char *page, size_t size);
+    static void trim(); // hand every cached page back to malloc
+    static PoolStats stats();
+    static void logStats();
+};
+
+#endif
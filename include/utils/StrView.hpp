@@ -0,0 +1,51 @@
+#ifndef WEBSERV_STRVIEW_HPP
+#define WEBSERV_STRVIEW_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// non-owning (pointer, length) view, valid as long as the buffer it points into is untouched
+struct StrView
+{
+    const char *data;
+    size_t size;
+
+    StrView() : data(NULL), size(0) {}
+    StrView(const char *d, size_t s) : data(d), size(s) {}
+
+    bool empty() const { return size == 0; }
+    std::string str() const { return data ? std::string(data, size) : std::string(); }
+
+    bool equals(const char *s) const
+    {
+        size_t len = std::strlen(s);
+        return len == size && std::memcmp(data, s, len) == 0;
+    }
+
+    // case-insensitive compare against a lowercase literal
+    bool iequals(const char *lower) const
+    {
+        size_t i = 0;
+        for (; i < size && lower[i]; ++i)
+        {
+            char c = data[i];
+            if (c >= 'A' && c <= 'Z')
+                c += 'a' - 'A';
+            if (c != lower[i])
+                return false;
+        }
+        return i == size && !lower[i];
+    }
+
+    size_t find(const char *s, size_t from = 0) const
+    {
+        size_t len = std::strlen(s);
+        for (size_t i = from; len <= size && i <= size - len; ++i)
+            if (std::memcmp(data + i, s, len) == 0)
+                return i;
+        return std::string::npos;
+    }
+};
+
+#endif
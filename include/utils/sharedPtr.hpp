@@ -35,7 +35,10 @@ public:
 
     /// @brief Copy constructor (shares ownership)
     /// @param copy Shared pointer to copy from
-    sharedPtr<_T>(const sharedPtr<_T> &copy)
+    sharedPtr<_T>(const sharedPtr<_T> &copy):
+        _count(NULL),
+        _ptr(NULL),
+        _deleter(NULL)
     { *this = copy; }
 
     /// @brief Destructor (decrements reference count)
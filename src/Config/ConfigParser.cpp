@@ -1,4 +1,5 @@
 #include "ConfigParser.hpp"
+#include <unistd.h>
 
 ServerConfig::ServerConfig()
 {
@@ -9,24 +10,32 @@ ServerConfig::ServerConfig()
     root = "/";
     indexFiles.push_back("index.html");
     maxBody = 10485760;
-    client_timeout = 60;
+    client_timeout = 60 * 1000;
+    edgeTriggered = false;
+    acceptBatch = 64;
+    maxConnections = 0;
+    overloadReject = false;
+    retryAfter = 1;
+    headerBufferSize = 1024;
+    largeHeaderBuffers = 4;
+    largeHeaderBufferSize = 8192;
     errors[400] = getErrorPage(400);
     errors[403] = getErrorPage(403);
     errors[404] = getErrorPage(404);
     errors[500] = getErrorPage(500);
 }
 
-Location::Location(ServerConfig server)
+Location::Location(const ServerConfig &server)
 {
     route = "";
     root = server.root;
     cgi = "";
     scriptInterpreter = "";
-    cgi_timeout = 1000;
+    cgi_timeout = 1000 * 1000;
     redirect = "";
     upload = "";
     autoindex = false;
-    methods.push_back("GET");
+    methods = METHOD_GET | METHOD_HEAD | METHOD_OPTIONS;
     maxBody = server.maxBody;
     client_timeout = server.client_timeout;
     indexFiles = server.indexFiles;
@@ -53,6 +62,56 @@ void WebConfigFile::addServer(const ServerConfig &server)
     _servers.push_back(server);
 }
 
+size_t WebConfigFile::getWorkerThreads() const
+{
+    return (_workerThreads);
+}
+
+void WebConfigFile::setWorkerThreads(size_t n)
+{
+    _workerThreads = n;
+}
+
+size_t WebConfigFile::getWorkerProcesses() const
+{
+    return (_workerProcesses);
+}
+
+void WebConfigFile::setWorkerProcesses(size_t n)
+{
+    _workerProcesses = n;
+}
+
+size_t WebConfigFile::getMaxConnections() const
+{
+    return (_maxConnections);
+}
+
+void WebConfigFile::setMaxConnections(size_t n)
+{
+    _maxConnections = n;
+}
+
+int WebConfigFile::getShutdownTimeout() const
+{
+    return (_shutdownTimeout);
+}
+
+void WebConfigFile::setShutdownTimeout(int ms)
+{
+    _shutdownTimeout = ms;
+}
+
+size_t WebConfigFile::getBufferPoolSize() const
+{
+    return (_bufferPoolSize);
+}
+
+void WebConfigFile::setBufferPoolSize(size_t bytes)
+{
+    _bufferPoolSize = bytes;
+}
+
 string trim(const string &str)
 {
     size_t start = str.find_first_not_of(" \t\n\r");
@@ -149,6 +208,32 @@ size_t myAtol(string str, string &line, const string &fname, size_t &lnNbr)
     return (atol(str.c_str()));
 }
 
+// "250ms", "1.5s" or a bare number of seconds, returned in milliseconds
+int parseDuration(string str, string &line, const string &fname, size_t &lnNbr)
+{
+    double scale = 1000;
+    if (str.size() > 2 && str.compare(str.size() - 2, 2, "ms") == 0)
+    {
+        scale = 1;
+        str.erase(str.size() - 2);
+    }
+    else if (str.size() > 1 && str[str.size() - 1] == 's')
+        str.erase(str.size() - 1);
+
+    if (str.empty() || str[0] == '.' || std::count(str.begin(), str.end(), '.') > 1)
+        throwSyntaxError(line, fname, lnNbr);
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        if (!isdigit(str[i]) && str[i] != '.')
+            throwSyntaxError(line, fname, lnNbr);
+    }
+
+    double ms = atof(str.c_str()) * scale;
+    if (ms < 1 || ms > 2147483647.0)
+        throwSyntaxError(line, fname, lnNbr);
+    return (static_cast<int>(ms));
+}
+
 short handleLocation(string str, vector<string> &tokens, Location &locTmp, const string &fname, size_t &lnNbr)
 {
     if (tokens.size() < 2)
@@ -174,7 +259,7 @@ short handleLocation(string str, vector<string> &tokens, Location &locTmp, const
         locTmp.maxBody = myAtol(tokens[1], str, fname, lnNbr);
 
     else if (tokens.size() == 2 && tokens[0] == "client_timeout")
-        locTmp.client_timeout = myAtol(tokens[1], str, fname, lnNbr);
+        locTmp.client_timeout = parseDuration(tokens[1], str, fname, lnNbr);
 
     else if (tokens.size() == 2 && tokens[0] == "redirect")
         locTmp.redirect = tokens[1];
@@ -189,7 +274,7 @@ short handleLocation(string str, vector<string> &tokens, Location &locTmp, const
         locTmp.scriptInterpreter = tokens[1];
 
     else if (tokens.size() == 2 && tokens[0] == "cgi_timeout")
-        locTmp.cgi_timeout = myAtol(tokens[1], str, fname, lnNbr);
+        locTmp.cgi_timeout = parseDuration(tokens[1], str, fname, lnNbr);
 
     else if (tokens[0] == "index")
     {
@@ -207,19 +292,17 @@ short handleLocation(string str, vector<string> &tokens, Location &locTmp, const
 
     else if (tokens[0] == "methods")
     {
-        locTmp.methods.clear();
+        locTmp.methods = 0;
         for (size_t i = 1; i < tokens.size(); i++)
         {
-            for (size_t j = 0; j < locTmp.methods.size(); j++)
-            {
-                if (tokens[i] == locTmp.methods[j])
-                    throwSyntaxError(str, fname, lnNbr);
-            }
-
-            if (tokens[i] != "GET" && tokens[i] != "POST" && tokens[i] != "DELETE")
+            HttpMethod method = methodFromName(tokens[i].data(), tokens[i].size());
+            if (method == METHOD_UNKNOWN || (locTmp.methods & method))
                 throwSyntaxError(str, fname, lnNbr);
-            locTmp.methods.push_back(tokens[i]);
+            locTmp.methods |= method;
         }
+        locTmp.methods |= METHOD_OPTIONS;
+        if (locTmp.methods & METHOD_GET)
+            locTmp.methods |= METHOD_HEAD;
     }
 
     else
@@ -258,7 +341,56 @@ short handleServer(string str, vector<string> &tokens, ServerConfig &srvTmp, con
         srvTmp.maxBody = myAtol(tokens[1], str, fname, lnNbr);
 
     else if (tokens.size() == 2 && tokens[0] == "client_timeout")
-        srvTmp.client_timeout = myAtol(tokens[1], str, fname, lnNbr);
+        srvTmp.client_timeout = parseDuration(tokens[1], str, fname, lnNbr);
+
+    else if (tokens.size() == 2 && tokens[0] == "accept_batch")
+    {
+        srvTmp.acceptBatch = myAtol(tokens[1], str, fname, lnNbr);
+        if (srvTmp.acceptBatch == 0 || srvTmp.acceptBatch > 4096)
+            throwSyntaxError(str, fname, lnNbr);
+    }
+
+    else if (tokens.size() == 2 && tokens[0] == "max_connections")
+        srvTmp.maxConnections = myAtol(tokens[1], str, fname, lnNbr);
+
+    else if (tokens.size() == 2 && tokens[0] == "client_header_buffer_size")
+    {
+        srvTmp.headerBufferSize = myAtol(tokens[1], str, fname, lnNbr);
+        if (srvTmp.headerBufferSize == 0)
+            throwSyntaxError(str, fname, lnNbr);
+    }
+
+    else if (tokens.size() == 3 && tokens[0] == "large_client_header_buffers")
+    {
+        srvTmp.largeHeaderBuffers = myAtol(tokens[1], str, fname, lnNbr);
+        srvTmp.largeHeaderBufferSize = myAtol(tokens[2], str, fname, lnNbr);
+        if (srvTmp.largeHeaderBuffers == 0 || srvTmp.largeHeaderBufferSize == 0)
+            throwSyntaxError(str, fname, lnNbr);
+    }
+
+    else if ((tokens.size() == 2 || tokens.size() == 3) && tokens[0] == "overload_policy")
+    {
+        if (tokens[1] == "pause" && tokens.size() == 2)
+            srvTmp.overloadReject = false;
+        else if (tokens[1] == "reject")
+        {
+            srvTmp.overloadReject = true;
+            if (tokens.size() == 3)
+                srvTmp.retryAfter = myAtol(tokens[2], str, fname, lnNbr);
+        }
+        else
+            throwSyntaxError(str, fname, lnNbr);
+    }
+
+    else if (tokens.size() == 2 && tokens[0] == "edge_triggered")
+    {
+        if (tokens[1] == "on")
+            srvTmp.edgeTriggered = true;
+        else if (tokens[1] == "off")
+            srvTmp.edgeTriggered = false;
+        else
+            throwSyntaxError(str, fname, lnNbr);
+    }
 
     else if (tokens[0] == "index")
     {
@@ -283,12 +415,59 @@ short handleServer(string str, vector<string> &tokens, ServerConfig &srvTmp, con
     return (0);
 }
 
-short handleDirective(string &str, const string &fName, size_t &lnNbr, WebConfigFile &config)
+size_t workerCount(string str, string &token, const string &fname, size_t &lnNbr)
 {
-    static bool srvActive = false;
-    static bool inLocation = false;
-    static ServerConfig srvTmp;
-    static Location locTmp(srvTmp);
+    if (token == "auto")
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        return (cores > 0 ? cores : 1);
+    }
+    size_t n = myAtol(token, str, fname, lnNbr);
+    if (n == 0 || n > 1024)
+        throwSyntaxError(str, fname, lnNbr);
+    return (n);
+}
+
+short handleMain(string str, vector<string> &tokens, WebConfigFile &config, const string &fname, size_t &lnNbr)
+{
+    if (tokens.size() == 2 && tokens[0] == "worker_threads")
+        config.setWorkerThreads(workerCount(str, tokens[1], fname, lnNbr));
+
+    else if (tokens.size() == 2 && tokens[0] == "worker_processes")
+        config.setWorkerProcesses(workerCount(str, tokens[1], fname, lnNbr));
+
+    else if (tokens.size() == 2 && tokens[0] == "shutdown_timeout")
+        config.setShutdownTimeout(parseDuration(tokens[1], str, fname, lnNbr));
+
+    else if (tokens.size() == 2 && tokens[0] == "max_connections")
+        config.setMaxConnections(myAtol(tokens[1], str, fname, lnNbr));
+
+    else if (tokens.size() == 2 && tokens[0] == "buffer_pool_size")
+        config.setBufferPoolSize(myAtol(tokens[1], str, fname, lnNbr));
+
+    else
+        throwSyntaxError(str, fname, lnNbr);
+
+    return (0);
+}
+
+// block nesting of one parse, kept per file so a config can be parsed again (reload)
+struct ParseState
+{
+    bool srvActive;
+    bool inLocation;
+    ServerConfig srvTmp;
+    Location locTmp;
+
+    ParseState() : srvActive(false), inLocation(false), locTmp(srvTmp) {}
+};
+
+short handleDirective(string &str, const string &fName, size_t &lnNbr, WebConfigFile &config, ParseState &state)
+{
+    bool &srvActive = state.srvActive;
+    bool &inLocation = state.inLocation;
+    ServerConfig &srvTmp = state.srvTmp;
+    Location &locTmp = state.locTmp;
 
     vector<string> tokens = split(str);
     if (tokens.empty())
@@ -344,12 +523,12 @@ short handleDirective(string &str, const string &fName, size_t &lnNbr, WebConfig
     else if (srvActive)
         return (handleServer(str, tokens, srvTmp, fName, lnNbr));
     else
-        throwSyntaxError(str, fName, lnNbr);
+        return (handleMain(str, tokens, config, fName, lnNbr));
 
     return (0);
 }
 
-WebConfigFile::WebConfigFile(const string &fName)
+WebConfigFile::WebConfigFile(const string &fName) : _workerThreads(1), _workerProcesses(1), _maxConnections(0), _shutdownTimeout(10 * 1000), _bufferPoolSize(0)
 {
     _inputFile.open(fName.c_str());
     if (!_inputFile.is_open())
@@ -357,6 +536,7 @@ WebConfigFile::WebConfigFile(const string &fName)
 
     string currentLine;
     size_t lnNbr = 0;
+    ParseState state;
 
     while (getline(_inputFile, currentLine))
     {
@@ -365,11 +545,33 @@ WebConfigFile::WebConfigFile(const string &fName)
         if (currentLine.empty())
             continue;
 
-        handleDirective(currentLine, fName, lnNbr, *this);
+        handleDirective(currentLine, fName, lnNbr, *this, state);
     }
 
     if (lnNbr == 0)
         throw runtime_error("Error: Configuration file is empty " + fName);
+
+    if (state.srvActive || state.inLocation)
+        throw runtime_error("Error: Unclosed block at end of " + fName);
+
+    if (_workerThreads > 1 && _workerProcesses > 1)
+        throw runtime_error("Error: worker_threads and worker_processes are mutually exclusive in " + fName);
+
+    // SO_REUSEPORT would let two servers bind the same address and split its connections between them
+    for (size_t i = 0; i < _servers.size(); ++i)
+    {
+        for (size_t j = 0; j < i; ++j)
+        {
+            const ServerConfig &a = _servers[i];
+            const ServerConfig &b = _servers[j];
+            if (a.port == b.port && (a.host == b.host || a.host == "0.0.0.0" || b.host == "0.0.0.0"))
+            {
+                ostringstream port;
+                port << a.port;
+                throw runtime_error("Error: duplicate listen address " + a.host + ":" + port.str() + " in " + fName);
+            }
+        }
+    }
 }
 
 WebConfigFile::~WebConfigFile()
@@ -0,0 +1,106 @@
+#include "ConfigStore.hpp"
+#include "Logger.hpp"
+#include <csignal>
+#include <sstream>
+
+#define SSTR(x) static_cast<std::ostringstream &>((std::ostringstream() << x)).str()
+
+extern volatile sig_atomic_t g_reload;
+
+std::string intToString(int value);
+
+std::string ConfigStore::_path;
+std::vector<ServerConfig> ConfigStore::_servers;
+unsigned ConfigStore::_generation = 0;
+pthread_mutex_t ConfigStore::_lock = PTHREAD_MUTEX_INITIALIZER;
+size_t ConfigStore::_workerThreads = 1;
+size_t ConfigStore::_workerProcesses = 1;
+size_t ConfigStore::_maxConnections = 0;
+int ConfigStore::_shutdownTimeout = 0;
+size_t ConfigStore::_bufferPoolSize = 0;
+
+void ConfigStore::init(const std::string &path, WebConfigFile &config)
+{
+    _path = path;
+    _servers = config.getServers();
+    _workerThreads = config.getWorkerThreads();
+    _workerProcesses = config.getWorkerProcesses();
+    _maxConnections = config.getMaxConnections();
+    _shutdownTimeout = config.getShutdownTimeout();
+    _bufferPoolSize = config.getBufferPoolSize();
+}
+
+// main-context directives are read once at startup, say so instead of letting the new value look live
+void ConfigStore::_warnUnapplied(const WebConfigFile &config)
+{
+    Logger logger;
+    std::vector<std::string> changed;
+
+    if (config.getWorkerThreads() != _workerThreads)
+        changed.push_back("worker_threads " + SSTR(_workerThreads << " -> " << config.getWorkerThreads()));
+    if (config.getWorkerProcesses() != _workerProcesses)
+        changed.push_back("worker_processes " + SSTR(_workerProcesses << " -> " << config.getWorkerProcesses()));
+    if (config.getMaxConnections() != _maxConnections)
+        changed.push_back("max_connections " + SSTR(_maxConnections << " -> " << config.getMaxConnections()));
+    if (config.getShutdownTimeout() != _shutdownTimeout)
+        changed.push_back("shutdown_timeout " + SSTR(_shutdownTimeout << "ms -> " << config.getShutdownTimeout() << "ms"));
+    if (config.getBufferPoolSize() != _bufferPoolSize)
+        changed.push_back("buffer_pool_size " + SSTR(_bufferPoolSize << " -> " << config.getBufferPoolSize()));
+
+    for (size_t i = 0; i < changed.size(); ++i)
+        logger.warning("Reload: " + changed[i] + " not applied, main-context directives need a restart");
+}
+
+// listeners are bound once at startup, a reload can only change what is behind them
+bool ConfigStore::_sameListeners(const std::vector<ServerConfig> &servers)
+{
+    if (servers.size() != _servers.size())
+        return false;
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        if (servers[i].host != _servers[i].host || servers[i].port != _servers[i].port)
+            return false;
+    }
+    return true;
+}
+
+unsigned ConfigStore::refresh()
+{
+    if (!g_reload)
+        return __atomic_load_n(&_generation, __ATOMIC_ACQUIRE);
+
+    Logger logger;
+    pthread_mutex_lock(&_lock);
+    if (g_reload)
+    {
+        g_reload = 0;
+        try
+        {
+            WebConfigFile config(_path);
+            if (!_sameListeners(config.getServers()))
+                logger.error("Reload rejected: listen addresses changed, a restart is needed to apply " + _path);
+            else
+            {
+                _servers = config.getServers();
+                _warnUnapplied(config);
+                __atomic_store_n(&_generation, _generation + 1, __ATOMIC_RELEASE);
+                logger.info("Configuration reloaded from " + _path + " (generation " + intToString(_generation) + ")");
+            }
+        }
+        catch (const std::exception &e)
+        {
+            logger.error(std::string("Reload failed, keeping the running configuration: ") + e.what());
+        }
+    }
+    unsigned generation = _generation;
+    pthread_mutex_unlock(&_lock);
+    return generation;
+}
+
+std::vector<ServerConfig> ConfigStore::snapshot()
+{
+    pthread_mutex_lock(&_lock);
+    std::vector<ServerConfig> servers = _servers;
+    pthread_mutex_unlock(&_lock);
+    return servers;
+}
@@ -22,15 +22,15 @@ bool RouteMatch::isUploadAllowed() const
     return (!uploadDir.empty());
 }
 
-Routing::Routing(ServerConfig &server) : _server(server)
+Routing::Routing(const ServerConfigPtr &server) : _server(server)
 {
 }
 
-RouteMatch Routing::match(const string &path, const string &method)
+RouteMatch Routing::match(const string &path, HttpMethod method)
 {
     RouteMatch result;
 
-    Location *loc = _findLocation(path);
+    const Location *loc = _findLocation(path);
     if (!loc)
         return (result);
 
@@ -68,36 +68,26 @@ RouteMatch Routing::match(const string &path, const string &method)
 
 string Routing::getErrorPage(int code)
 {
-    if (_server.errors.find(code) != _server.errors.end())
-        return (_server.errors[code]);
+    map<int, string>::const_iterator it = _server->errors.find(code);
+    if (it != _server->errors.end())
+        return (it->second);
 
     return ("");
 }
 
-string Routing::getAllowedMethodsStr(Location &loc)
+string Routing::getAllowedMethodsStr(const Location &loc)
 {
-    if (loc.methods.empty())
-        return ("GET, POST, DELETE");
-
-    std::string res;
-    for (size_t i = 0; i < loc.methods.size(); ++i)
-    {
-        res += loc.methods[i];
-        if (i < loc.methods.size() - 1)
-            res += ", ";
-    }
-
-    return (res);
+    return (methodList(loc.methods));
 }
 
-Location *Routing::_findLocation(const string &path)
+const Location *Routing::_findLocation(const string &path)
 {
-    Location *bestMatch = NULL;
+    const Location *bestMatch = NULL;
     size_t bestLen = 0;
 
-    for (size_t i = 0; i < _server.locations.size(); ++i)
+    for (size_t i = 0; i < _server->locations.size(); ++i)
     {
-        Location &loc = _server.locations[i];
+        const Location &loc = _server->locations[i];
         if (_matchesRoute(path, loc.route) && loc.route.length() > bestLen)
         {
             bestMatch = &loc;
@@ -121,7 +111,7 @@ bool Routing::_matchesRoute(const string &path, const string &route)
     return (false);
 }
 
-string Routing::_resolvePath(Location &loc, const string &reqPath)
+string Routing::_resolvePath(const Location &loc, const string &reqPath)
 {
     std::string root = _getRoot(loc);
     std::string relative = _getRelativePath(reqPath, loc.route);
@@ -177,7 +167,7 @@ string Routing::_getRelativePath(const string &path, const string &route)
     return (path);
 }
 
-bool Routing::_isCGI(Location &loc)
+bool Routing::_isCGI(const Location &loc)
 {
     return (!loc.cgi.empty());
 }
@@ -196,18 +186,9 @@ void Routing::_splitCGIPath(const string &fsPath, string &scriptPath, string &pa
     pathInfo = fsPath.substr(tmp.length());
 }
 
-bool Routing::_isMethodAllowed(Location &loc, const string &method)
+bool Routing::_isMethodAllowed(const Location &loc, HttpMethod method)
 {
-    if (loc.methods.empty())
-        return (true);
-
-    for (size_t i = 0; i < loc.methods.size(); ++i)
-    {
-        if (loc.methods[i] == method)
-            return (true);
-    }
-
-    return (false);
+    return ((loc.methods & method) != 0);
 }
 
 bool Routing::_isPathExists(const string &path)
@@ -228,20 +209,20 @@ bool Routing::_isFile(const string &path)
     return (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode));
 }
 
-string Routing::_getRoot(Location &loc)
+string Routing::_getRoot(const Location &loc)
 {
-    return (loc.root.empty() ? _server.root : loc.root);
+    return (loc.root.empty() ? _server->root : loc.root);
 }
 
-size_t Routing::_getMaxBodySize(Location &loc)
+size_t Routing::_getMaxBodySize(const Location &loc)
 {
-    return (loc.maxBody ? loc.maxBody : _server.maxBody);
+    return (loc.maxBody ? loc.maxBody : _server->maxBody);
 }
 
-vector<string> Routing::_getIndexFiles(Location &loc)
+vector<string> Routing::_getIndexFiles(const Location &loc)
 {
     if (!loc.indexFiles.empty())
         return (loc.indexFiles);
 
-    return (_server.indexFiles);
+    return (_server->indexFiles);
 }
@@ -3,33 +3,42 @@
 void CGIHandler::onEvent(uint32_t events)
 {
 	Logger logger;
-	_updateExpiresAt(time(NULL) + _match.location->cgi_timeout);
+	_updateExpiresAt(Timer::now() + _match.location->cgi_timeout);
 	if (IS_ERROR_EVENT(events))
 	{
 		onError();
-		return;
-	}
-	if (IS_READ_EVENT(events))
-	{
-		onReadable();
-	}
-	if (IS_WRITE_EVENT(events))
-	{
-		onWritable();
 	}
-	if (IS_TIMEOUT_EVENT(events))
+	else
 	{
-		onTimeout();
+		if (IS_READ_EVENT(events))
+			onReadable();
+		if (IS_WRITE_EVENT(events))
+			onWritable();
+		if (IS_TIMEOUT_EVENT(events))
+			onTimeout();
 	}
+	// the client sleeps while it has nothing to send or its input is throttled
+	if (_owner)
+		_owner->resume();
 }
 
 void CGIHandler::onReadable()
 {
 	Logger logger;
-	
-	char buffer[BUFFER_SIZE];
-	ssize_t bytesRead = _outputPipe.read(buffer, BUFFER_SIZE);
 
+	if (_splicing && _outputPipe.available() > 0)
+	{
+		// the client moves these bytes to its socket, the pipe is watched again once it is empty
+		_pauseOutput();
+		return;
+	}
+
+	char *buffer = _fd_manager.ioBuffer();
+	ssize_t bytesRead = _outputPipe.read(buffer, IO_BUFFER_SIZE);
+
+	// the client spliced what woke us up in the same batch of events
+	if (bytesRead < 0 && errno == EAGAIN)
+		return;
 	if (bytesRead < 0)
 	{
 		logger.error("CGI read error");
@@ -39,6 +48,7 @@ void CGIHandler::onReadable()
 
 	if (bytesRead == 0)
 	{
+		_response.spliceFrom(-1);
 		_fd_manager.detachFd(_outputPipe.read_fd());
 		_outputPipe.closeRead();
 
@@ -71,26 +81,22 @@ void CGIHandler::onReadable()
 	{
 		
 		int statusCode = 200;
-		std::string cgiStatus = _cgiParser.getHeader("status");
+		StrView cgiStatus = _cgiParser.getHeader(HDR_STATUS);
 		if (!cgiStatus.empty())
 		{
-			statusCode = ft_atoi<int>(cgiStatus.c_str());
+			statusCode = ft_atoi<int>(cgiStatus.str());
 			if (statusCode == 0)
 				statusCode = 200;
 		}
 		
 		_response.startLine(statusCode);
 		
-		strmap& headers = _cgiParser.getHeaders();
-		for (strmap::iterator it = headers.begin(); it != headers.end(); ++it)
+		for (size_t i = 0; i < _cgiParser.headerCount(); ++i)
 		{
-			std::string key = it->first;
-			std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-			
-			if (key == "status")
+			if (_cgiParser.headerId(i) == HDR_STATUS)
 				continue;
 			
-			_response.addHeader(it->first, it->second);
+			_response.addHeader(_cgiParser.headerName(i).str(), _cgiParser.headerValue(i).str());
 		}
 		
 		_response.addHeader("Transfer-Encoding", "chunked");
@@ -101,58 +107,89 @@ void CGIHandler::onReadable()
 		
 	}
 
-	if (_cgiParser.getState() >= BODY)
+	if (_cgiParser.getState() >= BODY && !_cgiParser.getBody().empty())
+		_response.feedRAW(_cgiParser.getBody());
+
+	// what followed the headers in this read is queued, the rest of the body is spliced.
+	// a HEAD response drops the body, it is read and discarded instead
+	if (!_splicing && !_response.isHeadOnly() && _cgiParser.getState() >= BODY)
 	{
-		RingBuffer& body = _cgiParser.getBody();
-		size_t bodySize = body.read(buffer, sizeof(buffer));
-		
-		if (bodySize > 0)
-		{
-			_response.feedRAW(buffer, bodySize);
-		}
+		_splicing = true;
+		_response.spliceFrom(_outputPipe.read_fd());
 	}
+	// the client reads slower than the script writes
+	if (!_outputPaused && _response.pending() >= CGI_HIGH_WATER)
+		_pauseOutput();
+}
+
+// detached rather than masked, a paused pipe would still report the script's hangup
+void CGIHandler::_pauseOutput()
+{
+	_fd_manager.detachFd(_outputPipe.read_fd());
+	_outputPaused = true;
 }
 
 void CGIHandler::onWritable()
 {
-	if (!_needBody)
+	BufferChain& body = _Reqparser.getBody();
+
+	if (!_needBody || (body.empty() && _Reqparser.getState() == COMPLETE))
 	{
-		_fd_manager.detachFd(_inputPipe.write_fd());
-		_inputPipe.closeWrite();
+		_closeInput();
 		return;
 	}
-
-	RingBuffer& body = _Reqparser.getBody();
-	size_t available = body.getSize();
-
-	if (available == 0)
+	if (body.empty())
 	{
+		// the rest of the body is still on its way, bodyAvailable() re-arms stdin
 		_fd_manager.detachFd(_inputPipe.write_fd());
-		_inputPipe.closeWrite();
+		_inputIdle = true;
 		return;
 	}
 
-	char buffer[BUFFER_SIZE];
-	size_t toWrite = (available > BUFFER_SIZE) ? BUFFER_SIZE : available;
-	size_t bytesRead = body.read(buffer, toWrite);
-
-	if (bytesRead > 0)
+	// only what the pipe took is consumed, the rest stays queued for the next wakeup
+	if (body.writeTo(_inputPipe.write_fd()) < 0 && errno != EAGAIN)
 	{
-		ssize_t bytesWritten = _inputPipe.write(buffer, bytesRead);
-		if (bytesWritten < 0)
-		{
-			Logger logger;
-			logger.error("CGI write error");
-			onError();
-			return;
-		}
+		Logger logger;
+		logger.error("CGI write error");
+		onError();
+		return;
 	}
+	if (body.empty() && _Reqparser.getState() == COMPLETE)
+		_closeInput();
+}
 
-	if (body.getSize() == 0)
-	{
-		_fd_manager.detachFd(_inputPipe.write_fd());
-		_inputPipe.closeWrite();
-	}
+void CGIHandler::_closeInput()
+{
+	if (_inputPipe.write_fd() == -1)
+		return;
+	_fd_manager.detachFd(_inputPipe.write_fd());
+	_inputPipe.closeWrite();
+	_inputIdle = false;
+}
+
+void CGIHandler::bodyAvailable()
+{
+	if (!_inputIdle || _inputPipe.write_fd() == -1)
+		return;
+	_inputIdle = false;
+	_fd_manager.add(_inputPipe.write_fd(), this, EPOLLOUT, false);
+}
+
+void CGIHandler::outputDrained()
+{
+	if (!_outputPaused || _response.pending() > CGI_LOW_WATER || _outputPipe.read_fd() == -1)
+		return;
+	// still being spliced by the client
+	if (_splicing && _outputPipe.available() > 0)
+		return;
+	_outputPaused = false;
+	_updateExpiresAt(Timer::now() + _match.location->cgi_timeout);
+	_fd_manager.add(_outputPipe.read_fd(), this, EPOLLIN);
+}
+
+bool CGIHandler::outputHandedOff() const
+{
+	return _splicing && _outputPaused;
 }
 
 void CGIHandler::onError()
@@ -160,11 +197,7 @@ void CGIHandler::onError()
 	Logger logger;
 
 	onReadable(); 
-	if (_inputPipe.write_fd() != -1)
-	{
-		_fd_manager.detachFd(_inputPipe.write_fd());
-		_inputPipe.closeWrite();
-	}
+	_closeInput();
 	int waitStatus = 0;
 	pid_t result = waitpid(_pid, &waitStatus, WNOHANG);
 
@@ -219,32 +252,33 @@ void CGIHandler::initEnv(HTTPParser &parser)
 	envStrings.push_back("SCRIPT_FILENAME=" + _scriptPath);
 	envStrings.push_back("QUERY_STRING=" + parser.getQuery());
 
-	envStrings.push_back("SERVER_NAME=" + (_config.host.empty() ? "localhost" : _config.host));
-	envStrings.push_back("SERVER_PORT=" + intToString(_config.port));
+	envStrings.push_back("SERVER_NAME=" + (_config->host.empty() ? "localhost" : _config->host));
+	envStrings.push_back("SERVER_PORT=" + intToString(_config->port));
 	envStrings.push_back("SERVER_SOFTWARE=WebServ/1.0");
 
 	// Remote address (would need to be passed from connection context)
 	// envStrings.push_back("REMOTE_ADDR=127.0.0.1");
 
-	strmap headers = parser.getHeaders();
-
-	if (headers.find("content-length") != headers.end())
-		envStrings.push_back("CONTENT_LENGTH=" + headers["content-length"]);
+	StrView contentLength = parser.getHeader(HDR_CONTENT_LENGTH);
+	if (contentLength.data)
+		envStrings.push_back("CONTENT_LENGTH=" + contentLength.str());
 	else
 		envStrings.push_back("CONTENT_LENGTH=0");
 
-	if (headers.find("content-type") != headers.end())
-		envStrings.push_back("CONTENT_TYPE=" + headers["content-type"]);
+	StrView contentType = parser.getHeader(HDR_CONTENT_TYPE);
+	if (contentType.data)
+		envStrings.push_back("CONTENT_TYPE=" + contentType.str());
 
-	for (strmap::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	for (size_t i = 0; i < parser.headerCount(); ++i)
 	{
-		if (it->first == "content-length" || it->first == "content-type")
+		HeaderId id = parser.headerId(i);
+		if (id == HDR_CONTENT_LENGTH || id == HDR_CONTENT_TYPE)
 			continue;
 
-		std::string key = it->first;
+		std::string key = parser.headerName(i).str();
 		std::transform(key.begin(), key.end(), key.begin(), ::toupper);
 		std::replace(key.begin(), key.end(), '-', '_');
-		envStrings.push_back("HTTP_" + key + "=" + it->second);
+		envStrings.push_back("HTTP_" + key + "=" + parser.headerValue(i).str());
 	}
 
 	_env.clear();
@@ -257,7 +291,7 @@ void CGIHandler::initEnv(HTTPParser &parser)
 	_env.push_back(NULL); 
 }
 
-CGIHandler::CGIHandler(HTTPParser &parser, HTTPResponse &response, ServerConfig &config, FdManager &fdm)
+CGIHandler::CGIHandler(HTTPParser &parser, HTTPResponse &response, const ServerConfigPtr &config, FdManager &fdm, EventHandler *owner)
 : EventHandler(config, fdm, -1),
     _scriptPath(""),
     _inputPipe(),
@@ -267,8 +301,12 @@ CGIHandler::CGIHandler(HTTPParser &parser, HTTPResponse &response, ServerConfig
     _Reqparser(parser),
     _cgiParser(),
     _response(response),
+    _owner(owner),
     _isRunning(false),
     _needBody(false),
+    _inputIdle(false),
+    _outputPaused(false),
+    _splicing(false),
 	_ShouldAddSLine(true)
 {
 	_cgiParser.setCGIMode(true); 
@@ -356,6 +394,11 @@ void CGIHandler::start(const RouteMatch &match, bool body_availelbe)
 	}
 	else
 	{
+		// the script's ends first: O_NONBLOCK is shared with the child through fork,
+		// and a script writing a full stdout pipe must block, not fail with EAGAIN
+		_inputPipe.closeRead();
+		_outputPipe.closeWrite();
+
         try 
         {
             _inputPipe.set_non_blocking();
@@ -366,12 +409,9 @@ void CGIHandler::start(const RouteMatch &match, bool body_availelbe)
             throw std::runtime_error("Failed to set non-blocking mode for CGI pipes: " + std::string(e.what()));
         }
 
-		_inputPipe.closeRead();
-		_outputPipe.closeWrite();
-
-		RingBuffer body = _Reqparser.getBody();
-		_expiresAt = time(NULL) + match.location->cgi_timeout;
-		if (_needBody && body.getSize() > 0)
+		_expiresAt = Timer::now() + match.location->cgi_timeout;
+		// the body may still be arriving, onWritable() idles stdin until it does
+		if (_needBody)
 		{
 			_fd_manager.add(_inputPipe.write_fd(), this, EPOLLOUT, false);
 		}
@@ -383,7 +423,6 @@ void CGIHandler::start(const RouteMatch &match, bool body_availelbe)
 		_fd_manager.add(_outputPipe.read_fd(), this, EPOLLIN);
 
 		_isRunning = true;
-		expires_at = time(NULL) + match.location->cgi_timeout;
 		for (size_t i = 0; i < _env.size(); ++i)
 		{
 			delete[] _env[i];
@@ -404,6 +443,7 @@ bool CGIHandler::isRunning() const
 
 void CGIHandler::end()
 {
+	_response.spliceFrom(-1);
 	_fd_manager.remove(_inputPipe.write_fd());
 	_fd_manager.remove(_outputPipe.read_fd());
 	_inputPipe.close();
@@ -449,6 +489,9 @@ void CGIHandler::reset()
 	status = 0;
 	_isRunning = false;
 	_needBody = false;
+	_inputIdle = false;
+	_outputPaused = false;
+	_splicing = false;
 	_ShouldAddSLine = true;
 
 	_cgiParser.reset();
@@ -18,6 +18,10 @@ static std::string emptyPage =
 
 void initErrorPages()
 {
+    // ServerConfig() calls this, a config reload must not rewrite pages other threads are reading
+    if (!defaultErrorPages.empty())
+        return;
+
     defaultErrorPages[301] =
         "<html>" CRLF
         "<head><title>301 Moved Permanently</title></head>" CRLF
@@ -156,6 +160,12 @@ void initErrorPages()
         "<body>" CRLF
         "<center><h1>429 Too Many Requests</h1></center>" CRLF;
 
+    defaultErrorPages[431] =
+        "<html>" CRLF
+        "<head><title>431 Request Header Fields Too Large</title></head>" CRLF
+        "<body>" CRLF
+        "<center><h1>431 Request Header Fields Too Large</h1></center>" CRLF;
+
     defaultErrorPages[494] =
         "<html>" CRLF
         "<head><title>400 Request Header Or Cookie Too Large</title></head>" CRLF
@@ -0,0 +1,49 @@
+#include "HTTPHeaders.hpp"
+
+#define HDR_SLOTS 64
+
+// (len + first + 4 * last) & 63 over the lowercased name has no collisions for the
+// names below, a new name needs a free slot (or new constants) before it is added
+#define HDR_HASH(len, first, last) (((len) + ((first) | 0x20) + 4 * ((last) | 0x20)) & (HDR_SLOTS - 1))
+
+static const char *const g_names[HDR_COUNT] = {
+    "host", "connection", "content-length", "content-type", "transfer-encoding",
+    "expect", "cookie", "user-agent", "accept", "accept-encoding", "accept-language",
+    "authorization", "referer", "range", "if-modified-since", "if-none-match",
+    "origin", "upgrade", "keep-alive", "cache-control", "status", "location"};
+
+static const signed char g_slots[HDR_SLOTS] = {
+    -1, HDR_REFERER, -1, HDR_CONTENT_TYPE, HDR_ACCEPT_LANGUAGE, HDR_STATUS, -1, -1,
+    -1, HDR_KEEP_ALIVE, -1, HDR_RANGE, HDR_ACCEPT_ENCODING, -1, HDR_IF_MODIFIED_SINCE, HDR_USER_AGENT,
+    HDR_UPGRADE, HDR_CONTENT_LENGTH, -1, -1, -1, -1, HDR_IF_NONE_MATCH, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1,
+    HDR_CACHE_CONTROL, HDR_TRANSFER_ENCODING, -1, -1, -1, HDR_CONNECTION, HDR_AUTHORIZATION, -1,
+    -1, -1, -1, -1, HDR_LOCATION, HDR_ORIGIN, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, HDR_ACCEPT,
+    -1, -1, -1, HDR_EXPECT, HDR_HOST, HDR_COOKIE, -1, -1};
+
+HeaderId headerId(const char *name, size_t len)
+{
+    if (!len)
+        return HDR_UNKNOWN;
+    int slot = g_slots[HDR_HASH(len, name[0], name[len - 1])];
+    if (slot < 0)
+        return HDR_UNKNOWN;
+
+    // one candidate left, confirm the whole name
+    const char *known = g_names[slot];
+    for (size_t i = 0; i < len; ++i)
+    {
+        char c = name[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        if (c != known[i]) // also stops at the end of a shorter known name
+            return HDR_UNKNOWN;
+    }
+    return known[len] ? HDR_UNKNOWN : static_cast<HeaderId>(slot);
+}
+
+const char *headerIdName(HeaderId id)
+{
+    return id > HDR_UNKNOWN && id < HDR_COUNT ? g_names[id] : "";
+}
@@ -0,0 +1,47 @@
+#include "HTTPMethod.hpp"
+#include <cstring>
+
+static const struct
+{
+    const char *name;
+    size_t len;
+    HttpMethod method;
+} g_methods[] = {
+    {"GET", 3, METHOD_GET},
+    {"HEAD", 4, METHOD_HEAD},
+    {"POST", 4, METHOD_POST},
+    {"PUT", 3, METHOD_PUT},
+    {"DELETE", 6, METHOD_DELETE},
+    {"OPTIONS", 7, METHOD_OPTIONS}};
+
+#define METHOD_COUNT (sizeof(g_methods) / sizeof(g_methods[0]))
+
+HttpMethod methodFromName(const char *name, size_t len)
+{
+    for (size_t i = 0; i < METHOD_COUNT; ++i)
+        if (g_methods[i].len == len && std::memcmp(g_methods[i].name, name, len) == 0)
+            return g_methods[i].method;
+    return METHOD_UNKNOWN;
+}
+
+const char *methodName(HttpMethod method)
+{
+    for (size_t i = 0; i < METHOD_COUNT; ++i)
+        if (g_methods[i].method == method)
+            return g_methods[i].name;
+    return "";
+}
+
+std::string methodList(unsigned mask)
+{
+    std::string list;
+    for (size_t i = 0; i < METHOD_COUNT; ++i)
+    {
+        if (!(mask & g_methods[i].method))
+            continue;
+        if (!list.empty())
+            list += ", ";
+        list += g_methods[i].name;
+    }
+    return list;
+}
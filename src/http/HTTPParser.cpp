@@ -1,24 +1,40 @@
 #include "HTTPParser.hpp"
+#include "HTTPScan.hpp"
 #include <iostream>
 #include <cstdio>
+#include <cstring>
 
 HTTPParser::HTTPParser():
-    _body(BUFF_SIZE * 16),
+    _methodId(METHOD_UNKNOWN),
+    _versionId(HTTP_UNKNOWN),
+    _headEnd(0),
+    _body(),
     _contentLength(0),
     _bytesRead(0),
     _isChunked(false),
     _chunkSize(0),
     _readChunkSize(0),
     _isMultiPart(false),
-    _MultiParser(_body),
+    _MultiParser(NULL),
     _bodyHandler(NULL),
     _data(NULL),
     _isCGIResponse(false),
     _state(START_LINE),
     _buffOffset(0),
+    _scanPos(0),
+    _colonPos(NPOS),
+    _lineMax(LARGE_HEADER_SIZE),
+    _headMax(LARGE_HEADER_COUNT * LARGE_HEADER_SIZE),
+    _errorStatus(400),
     _bodySize(0)
 {
-    _buffer.reserve(BUFF_SIZE);
+    _fields.reserve(HEADERS_RESERVE);
+    std::memset(_known, 0, sizeof(_known));
+}
+
+HTTPParser::~HTTPParser()
+{
+    delete _MultiParser;
 }
 
 std::string&    HTTPParser::getMethod(void) { return _method; }
@@ -26,11 +42,34 @@ std::string&    HTTPParser::getVers(void) { return _version; }
 std::string&    HTTPParser::getUri(void) { return _uri; }
 std::string&    HTTPParser::getQuery(void) { return _query; }
 std::string&    HTTPParser::getFragment(void) { return _fragment; }
+HttpMethod      HTTPParser::getMethodId(void) const { return _methodId; }
+HttpVersion     HTTPParser::getVersionId(void) const { return _versionId; }
+
+size_t  HTTPParser::headerCount(void) const { return _fields.size(); }
+StrView HTTPParser::headerName(size_t i) const { return StrView(_buffer.data() + _fields[i].name, _fields[i].nameLen); }
+StrView HTTPParser::headerValue(size_t i) const { return StrView(_buffer.data() + _fields[i].value, _fields[i].valueLen); }
+
+HeaderId HTTPParser::headerId(size_t i) const { return _fields[i].id; }
+
+StrView HTTPParser::getHeader(HeaderId id) const
+{
+    if (id == HDR_UNKNOWN || !_known[id])
+        return StrView();
+    return headerValue(_known[id] - 1);
+}
 
-strmap&         HTTPParser::getHeaders(void) { return _headers; }
-std::string&    HTTPParser::getHeader(const std::string& key) { return _headers[key]; }
+StrView HTTPParser::getHeader(const char *key) const
+{
+    HeaderId id = ::headerId(key, std::strlen(key));
+    if (id != HDR_UNKNOWN)
+        return getHeader(id);
+    for (size_t i = 0; i < _fields.size(); ++i)
+        if (headerName(i).iequals(key))
+            return headerValue(i);
+    return StrView();
+}
 
-RingBuffer&     HTTPParser::getBody(void) { return _body; }
+BufferChain&    HTTPParser::getBody(void) { return _body; }
 size_t          HTTPParser::getBodySize(void) { return _bodySize; }
 bool            HTTPParser::hasBody(void) { return _contentLength || _isChunked; }
 
@@ -38,16 +77,24 @@ parse_state     HTTPParser::getState(void) { return _state; }
 bool    HTTPParser::isComplete(void)
 {
     if (_isMultiPart)
-        return _state == COMPLETE && _MultiParser.isComplete();
+        return _state == COMPLETE && _MultiParser->isComplete();
     return _state == COMPLETE;
 }
+int     HTTPParser::getErrorStatus(void) { return _errorStatus; }
 bool    HTTPParser::isError(void)
 {
     if (_isMultiPart)
-        return _state == ERROR || _MultiParser.isError();
+        return _state == ERROR || _MultiParser->isError();
     return _state == ERROR;
 }
 
+void    HTTPParser::setHeaderLimits(size_t bufferSize, size_t lineMax, size_t headMax)
+{
+    _buffer.reserve(bufferSize);
+    _lineMax = lineMax;
+    _headMax = headMax;
+}
+
 void    HTTPParser::setCGIMode(bool m) { _isCGIResponse = m; }
 bool    HTTPParser::getCGIMode(void) { return _isCGIResponse; }
 
@@ -55,9 +102,15 @@ void    HTTPParser::reset(void)
 {
     _method.clear();
     _uri.clear();
+    _query.clear();
+    _fragment.clear();
     _version.clear();
+    _methodId = METHOD_UNKNOWN;
+    _versionId = HTTP_UNKNOWN;
     _body.clear();
-    _headers.clear();
+    _fields.clear();
+    std::memset(_known, 0, sizeof(_known));
+    _headEnd = 0;
     
     if (_isCGIResponse)
         _state = HEADERS;
@@ -65,6 +118,9 @@ void    HTTPParser::reset(void)
         _state = START_LINE;
     _buffer.clear();
     _buffOffset = 0;
+    _scanPos = 0;
+    _colonPos = NPOS;
+    _errorStatus = 400;
 
     _isChunked = false;
     _chunkSize = 0;
@@ -78,7 +134,8 @@ void    HTTPParser::reset(void)
 
     _isMultiPart = false;
     _boundary.clear();
-    _MultiParser.reset();
+    delete _MultiParser;
+    _MultiParser = NULL;
 
     _bodySize = 0;
     //_isCGIResponse = false;
@@ -114,15 +171,13 @@ label:
     default: return;
     }
 
-    if (_state == BODY)
-        _bodySize = _contentLength;
-    else if (_state == CHUNK_DATA)
-        _bodySize += _chunkSize;
-
-    if (_buffOffset * 2 >= BUFF_SIZE)
+    // drop consumed body bytes but keep the head, the header views point into it
+    if (_state > HEADERS && (_buffOffset - _headEnd) * 2 >= BUFF_SIZE)
     {
-        _buffer.erase(0, _buffOffset);
-        _buffOffset = 0;
+        if (_scanPos)
+            _scanPos -= _buffOffset - _headEnd;
+        _buffer.erase(_headEnd, _buffOffset - _headEnd);
+        _buffOffset = _headEnd;
     }
     if (old_state != _state)
         goto label;
@@ -137,33 +192,47 @@ void    HTTPParser::_parseStartLine()
 
         Request-Line   = Method SP Request-URI SP HTTP-Version CRLF
     */
-    if (_buffer.empty())
-        return;
-    size_t idx = _buffer.find(CRLF);
-    if (idx == NPOS)
+    size_t idx = _lineEnd(0);
+    if (idx == NPOS || idx + 2 > _lineMax)
+    {
+        if (_state != ERROR && (idx != NPOS || _buffer.size() > _lineMax))
+            _fail(414);
         return;
+    }
     _buffOffset = idx + 2;
-    size_t i = 0;
-    size_t sp = 0;
-    for (size_t pos = 0; pos <= idx; ++pos)
+
+    const char *line = _buffer.data();
+    size_t sp1 = HTTPScan::find(line, idx, ' ', ' ');
+    size_t sp2 = sp1 == idx ? idx : sp1 + 1 + HTTPScan::find(line + sp1 + 1, idx - sp1 - 1, ' ', ' ');
+    if (sp2 == idx || HTTPScan::find(line + sp2 + 1, idx - sp2 - 1, ' ', ' ') != idx - sp2 - 1)
     {
-        if (_buffer[pos] != ' ' && pos != idx) continue;
-        switch (sp)
-        {
-        case 0: _method = _buffer.substr(i, pos - i); break;
-        case 1: _uri = _buffer.substr(i, pos - i); break;
-        case 2: _version = _buffer.substr(i, pos - i); break;
-        }
-        if (pos != idx && ++sp > 2) break;
-        i = pos + 1;
+        _state = ERROR;
+        return;
     }
-    if (sp != 2 || _method.empty() || _uri.empty() || _version.empty())
+    _method.assign(line, sp1);
+    _uri.assign(line + sp1 + 1, sp2 - sp1 - 1);
+    _version.assign(line + sp2 + 1, idx - sp2 - 1);
+    if (!HTTPScan::isToken(line, sp1) || _uri.empty() || _version.empty())
+    {
         _state = ERROR;
-    else
-        _state = HEADERS;
-    
-    if (_state == ERROR)
         return;
+    }
+    _methodId = methodFromName(line, sp1);
+
+    // HTTP-version = "HTTP/" DIGIT "." DIGIT
+    const char *vers = line + sp2 + 1;
+    if (_version.size() != 8 || std::memcmp(vers, "HTTP/", 5) != 0 || !isdigit(vers[5]) || vers[6] != '.' || !isdigit(vers[7]))
+    {
+        _state = ERROR;
+        return;
+    }
+    if (vers[5] != '1' || (vers[7] != '0' && vers[7] != '1'))
+    {
+        _fail(505);
+        return;
+    }
+    _versionId = (vers[7] == '1') ? HTTP_11 : HTTP_10;
+    _state = HEADERS;
 
     _decodeURI();
     if (_state == ERROR)
@@ -171,14 +240,14 @@ void    HTTPParser::_parseStartLine()
     size_t fragm = _uri.find('#');
     if (fragm != NPOS)
     {
-        _fragment = _uri.substr(fragm + 1);
-        _uri = _uri.erase(fragm);
+        _fragment.assign(_uri, fragm + 1, NPOS);
+        _uri.erase(fragm);
     }
     size_t query = _uri.find('?');
     if (query != NPOS)
     {
-        _query = _uri.substr(query + 1);
-        _uri = _uri.substr(0, query);
+        _query.assign(_uri, query + 1, NPOS);
+        _uri.erase(query);
     }
 }
 void    HTTPParser::_parseHeaders()
@@ -192,35 +261,63 @@ void    HTTPParser::_parseHeaders()
                          of token, separators, and quoted-string>
         NOTE: I don't feel like implementing the token,sperator quote stuff
     */
-    if (_buffer.empty())
-        return;
-
     while (true)
     {
-        size_t idx = _buffer.find(CRLF, _buffOffset);
-        if (idx == NPOS)
-            return;
-            
-        if (idx == _buffOffset) // end of headers
+        // one pass finds either the colon or the end of a line without one,
+        // a line cut by the end of the buffer resumes where the scan stopped
+        const char *data = _buffer.data();
+        if (_colonPos == NPOS)
+        {
+            size_t from = std::max(_buffOffset, _scanPos);
+            size_t pos = from + HTTPScan::find(data + from, _buffer.size() - from, ':', '\n');
+            if (pos == _buffer.size())
+            {
+                _scanPos = pos;
+                _checkHeadSize();
+                return;
+            }
+            _colonPos = pos;
+        }
+        size_t colon_pos = _colonPos;
+
+        if (data[colon_pos] == '\n')
         {
+            _colonPos = NPOS;
+            _scanPos = 0;
+            if (colon_pos != _buffOffset + 1 || data[_buffOffset] != '\r')
+            {
+                _state = ERROR;
+                return;
+            }
             _buffOffset += 2; // skip the empty line
+            _headEnd = _buffOffset;
             // Check if we need to parse body based on content length
-            strmap::iterator it = _headers.find("content-length");
-            strmap::iterator it2 = _headers.find("transfer-encoding");
-            if (it2 != _headers.end())
+            StrView len = getHeader(HDR_CONTENT_LENGTH);
+            StrView enc = getHeader(HDR_TRANSFER_ENCODING);
+            if (enc.data)
             {
-                std::string& enc = it2->second;
-                std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
-                _state = (it2->second == "chunked" ? CHUNK_SIZE : ERROR);
+                _state = (enc.iequals("chunked") ? CHUNK_SIZE : ERROR);
                 _isChunked = (_state == CHUNK_SIZE);
             }
-            else if (it != _headers.end()) // prioritize chunked over con-lenth
+            else if (len.data) // prioritize chunked over con-lenth
             {
-                char*   ptr = NULL;
-                ssize_t len = std::strtol(it->second.data(), &ptr, 10);
-                _state = (*ptr != '\0' || len < 0 ? ERROR : BODY);
-                if (_state == ERROR) return;
-                _contentLength = len;
+                _contentLength = 0;
+                for (size_t i = 0; i < len.size && _state != ERROR; ++i)
+                {
+                    size_t digit = len.data[i] - '0';
+                    // a wrapped length would frame the body differently than a proxy in front of us
+                    if (len.data[i] < '0' || len.data[i] > '9'
+                        || _contentLength > (~(size_t)0 - digit) / 10)
+                        _state = ERROR;
+                    else
+                        _contentLength = _contentLength * 10 + digit;
+                }
+                if (_state == ERROR || len.empty())
+                {
+                    _state = ERROR;
+                    return;
+                }
+                _bodySize = _contentLength;
                 _state = (_contentLength == 0) ? COMPLETE : BODY;
             }
             else
@@ -228,44 +325,70 @@ void    HTTPParser::_parseHeaders()
             break;
         }
 
-        // Find the first colon only
-        size_t colon_pos = _buffer.find(':', _buffOffset);
-        if (colon_pos == NPOS || colon_pos >= idx)
+        size_t idx = _lineEnd(colon_pos + 1);
+        if (idx == NPOS)
         {
-            _state = ERROR;
+            _checkHeadSize();
+            return;
+        }
+        _colonPos = NPOS;
+        if (idx + 2 - _buffOffset > _lineMax || idx + 2 > _headMax)
+        {
+            _fail(431);
             return;
         }
 
-        std::string key = _buffer.substr(_buffOffset, colon_pos - _buffOffset);
-        if (key.find_first_of(" \t") != NPOS)
+        HeaderField field;
+        field.name = _buffOffset;
+        field.nameLen = colon_pos - _buffOffset;
+        if (!HTTPScan::isToken(data + field.name, field.nameLen))
         {
             _state = ERROR;
             return;
         }
-        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
 
-        std::string value = _buffer.substr(colon_pos + 1, idx - colon_pos - 1);
-        
         // remove optional whitespace from value
-        size_t value_start = value.find_first_not_of(" \t");
-        size_t value_end = value.find_last_not_of(" \t");
-        
-        if (value_start != NPOS && value_end != NPOS)
-            value = value.substr(value_start, value_end - value_start + 1);
-        else
-            value.clear(); // all whitespace
-
-        _headers[key] = value;
+        size_t value_start = colon_pos + 1;
+        size_t value_end = idx;
+        while (value_start < value_end && (_buffer[value_start] == ' ' || _buffer[value_start] == '\t'))
+            ++value_start;
+        while (value_end > value_start && (_buffer[value_end - 1] == ' ' || _buffer[value_end - 1] == '\t'))
+            --value_end;
+        field.value = value_start;
+        field.valueLen = value_end - value_start;
+        field.id = ::headerId(data + field.name, field.nameLen);
+
+        // repeated Content-Length fields must agree (RFC 9112 6.3)
+        if (field.id == HDR_CONTENT_LENGTH && _known[field.id])
+        {
+            const HeaderField &first = _fields[_known[field.id] - 1];
+            if (first.valueLen != field.valueLen
+                || std::memcmp(data + first.value, data + field.value, field.valueLen))
+            {
+                _state = ERROR;
+                return;
+            }
+        }
+        _fields.push_back(field);
+        if (field.id != HDR_UNKNOWN && !_known[field.id])
+            _known[field.id] = _fields.size();
         _buffOffset = idx + 2;
     }
-    // why is this 
-    std::string& cont_type = getHeader("content-type");
-    if (cont_type.find("multipart/form-data") != NPOS)
+    // only a POST body is split into parts, anything else is passed on as it is
+    StrView cont_type = getHeader(HDR_CONTENT_TYPE);
+    if (_methodId == METHOD_POST && cont_type.find("multipart/form-data") != NPOS)
     {
-        _isMultiPart = true;
         size_t pos = cont_type.find("boundary=");
-        _boundary = cont_type.substr(pos + 9);
-        _MultiParser.setBoundry(_boundary);
+        if (pos == NPOS)
+        {
+            _state = ERROR;
+            return;
+        }
+        _isMultiPart = true;
+        _boundary.assign(cont_type.data + pos + 9, cont_type.size - pos - 9);
+        if (!_MultiParser)
+            _MultiParser = new Multipart(_body);
+        _MultiParser->setBoundry(_boundary);
     }
 }
 void    HTTPParser::_parseBody()
@@ -276,7 +399,7 @@ void    HTTPParser::_parseBody()
     size_t available = _buffer.size() - _buffOffset;
     if (_isCGIResponse)
     {
-        _body.write(_buffer.data() + _buffOffset, available);
+        _body.append(_buffer.data() + _buffOffset, available);
         _buffOffset += available;
         return;
     }
@@ -287,7 +410,7 @@ void    HTTPParser::_parseBody()
     if (_bodyHandler)
         _bodyHandler(_buffer.data() + _buffOffset, to_read, _data);
     else
-        _body.write(_buffer.data() + _buffOffset, to_read);
+        _body.append(_buffer.data() + _buffOffset, to_read);
     _bytesRead += to_read;
     _buffOffset += to_read;
     
@@ -297,22 +420,32 @@ void    HTTPParser::_parseBody()
 
 void    HTTPParser::_parseChunkedSize()
 {
-    if (_buffer.empty() || _buffOffset >= _buffer.size())
-        return;
-
-    size_t idx = _buffer.find(CRLF, _buffOffset);
+    size_t idx = _lineEnd(_buffOffset);
     if (idx == NPOS)
+    {
+        if (_buffer.size() - _buffOffset > _lineMax)
+            _state = ERROR;
         return;
+    }
 
-    std::string chunkLine = _buffer.substr(_buffOffset, idx - _buffOffset);
-    size_t extension_pos = chunkLine.find(';');
-    if (extension_pos != NPOS)
-        chunkLine = chunkLine.substr(0, extension_pos);
-
-    try {
-        _chunkSize = ft_atoi<size_t>(chunkLine);
+    // chunk-size [ BWS ";" chunk-ext ], the extensions are ignored
+    const char *data = _buffer.data();
+    size_t i = _buffOffset;
+    _chunkSize = 0;
+    for (; i < idx && isxdigit(static_cast<unsigned char>(data[i])); ++i)
+    {
+        if (_chunkSize >> (sizeof(size_t) * 8 - 4))
+        {
+            _state = ERROR; // overflow
+            return;
+        }
+        int c = tolower(static_cast<unsigned char>(data[i]));
+        _chunkSize = (_chunkSize << 4) | (c <= '9' ? c - '0' : c - 'a' + 10);
     }
-    catch (std::exception& e)
+    bool digits = (i != _buffOffset);
+    while (i < idx && (data[i] == ' ' || data[i] == '\t'))
+        ++i;
+    if (!digits || (i != idx && data[i] != ';'))
     {
         _state = ERROR;
         return;
@@ -327,6 +460,7 @@ void    HTTPParser::_parseChunkedSize()
         return;
     }
     
+    _bodySize += _chunkSize;
     _state = CHUNK_DATA;
 }
 void    HTTPParser::_parseChunkedSegment()
@@ -342,7 +476,7 @@ void    HTTPParser::_parseChunkedSegment()
         if (_bodyHandler)
             _bodyHandler(_buffer.data() + _buffOffset, to_read, _data);
         else
-            _body.write(_buffer.data() + _buffOffset, to_read);
+            _body.append(_buffer.data() + _buffOffset, to_read);
         _readChunkSize += to_read;
         _buffOffset += to_read;
     }
@@ -351,7 +485,7 @@ void    HTTPParser::_parseChunkedSegment()
         return;
     if (_buffer.size() - _buffOffset >= 2)
     {
-        if (_buffer.substr(_buffOffset, 2) == CRLF)
+        if (_buffer.compare(_buffOffset, 2, CRLF) == 0)
         {
             _buffOffset += 2;
             _state = CHUNK_SIZE;
@@ -361,12 +495,45 @@ void    HTTPParser::_parseChunkedSegment()
     }
 }
 
+// position of the CRLF ending the line that starts at 'from', NPOS while it is
+// incomplete. A bare LF is rejected rather than guessed at
+size_t  HTTPParser::_lineEnd(size_t from)
+{
+    size_t start = std::max(from, _scanPos);
+    size_t lf = start + HTTPScan::find(_buffer.data() + start, _buffer.size() - start, '\n', '\n');
+    if (lf == _buffer.size())
+    {
+        _scanPos = lf;
+        return NPOS;
+    }
+    _scanPos = 0;
+    if (lf == from || _buffer[lf - 1] != '\r')
+    {
+        _state = ERROR;
+        return NPOS;
+    }
+    return lf - 1;
+}
+
+// an incomplete header line may not outgrow one large buffer, nor the head all of them
+void    HTTPParser::_checkHeadSize()
+{
+    if (_state != ERROR && (_buffer.size() - _buffOffset > _lineMax || _buffer.size() > _headMax))
+        _fail(431);
+}
+
+void    HTTPParser::_fail(int status)
+{
+    _state = ERROR;
+    _errorStatus = status;
+}
+
 void    HTTPParser::setBodyHandler(bodyHandler bh, void *data)
 {
     _bodyHandler = bh;
     _data = data;
 }
-void    HTTPParser::setUploadDir(const std::string& dir) { _MultiParser.setUploadPath(dir); }
+void    HTTPParser::setUploadDir(const std::string& dir) { if (_MultiParser) _MultiParser->setUploadPath(dir); }
 
 void    HTTPParser::_decodeURI()
 {
@@ -398,7 +565,7 @@ void    HTTPParser::_decodeURI()
 void    HTTPParser::parseMultipart()
 {
     if (_isMultiPart)
-        _MultiParser.parse();
+        _MultiParser->parse();
 }
 
 bool    HTTPParser::isMultiPart() { return _isMultiPart; }
\ No newline at end of file
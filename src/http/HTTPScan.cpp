@@ -0,0 +1,160 @@
+#include "HTTPScan.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HTTPSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+HTTPScan::findKernel HTTPScan::_find = &HTTPScan::_findFirst;
+HTTPScan::tokenKernel HTTPScan::_token = &HTTPScan::_tokenFirst;
+
+bool HTTPScan::isTchar(unsigned char c)
+{
+    if ((c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z'))
+        return true;
+    return c && std::strchr("!#$%&'*+-.^_`|~", c);
+}
+
+static size_t findScalar(const char *p, size_t len, char a, char b)
+{
+    for (size_t i = 0; i < len; ++i)
+        if (p[i] == a || p[i] == b)
+            return i;
+    return len;
+}
+
+static size_t tokenScalar(const char *p, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+        if (!HTTPScan::isTchar(p[i]))
+            return i;
+    return len;
+}
+
+#ifdef HTTPSCAN_X86
+
+// the vector loops only load whole blocks, the tail goes through the scalar loop.
+// the token kernels accept [0-9A-Za-z-] in bulk and let the scalar check decide a
+// block that holds anything else
+
+static size_t findSSE2(const char *p, size_t len, char a, char b)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + findScalar(p + i, len - i, a, b);
+}
+
+static size_t tokenSSE2(const char *p, size_t len)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+        __m128i dash = _mm_cmpeq_epi8(v, _mm_set1_epi8('-'));
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, alpha), dash)) != 0xffff)
+        {
+            size_t bad = tokenScalar(p + i, 16);
+            if (bad != 16)
+                return i + bad;
+        }
+    }
+    return i + tokenScalar(p + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t findAVX2(const char *p, size_t len, char a, char b)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + findSSE2(p + i, len - i, a, b);
+}
+
+__attribute__((target("avx2")))
+static size_t tokenAVX2(const char *p, size_t len)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        __m256i dash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-'));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(digit, alpha), dash));
+        if (mask != 0xffffffffu)
+        {
+            size_t bad = tokenScalar(p + i, 32);
+            if (bad != 32)
+                return i + bad;
+        }
+    }
+    return i + tokenSSE2(p + i, len - i);
+}
+
+#endif
+
+void HTTPScan::_select()
+{
+#ifdef HTTPSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        _find = &findAVX2;
+        _token = &tokenAVX2;
+        return;
+    }
+    _find = &findSSE2;
+    _token = &tokenSSE2;
+#else
+    _find = &findScalar;
+    _token = &tokenScalar;
+#endif
+}
+
+// the kernels start out as these stubs, which pick the real ones and forward the call
+size_t HTTPScan::_findFirst(const char *p, size_t len, char a, char b)
+{
+    _select();
+    return _find(p, len, a, b);
+}
+
+size_t HTTPScan::_tokenFirst(const char *p, size_t len)
+{
+    _select();
+    return _token(p, len);
+}
+
+const char *HTTPScan::kernel()
+{
+    if (_find == &HTTPScan::_findFirst)
+        _select();
+#ifdef HTTPSCAN_X86
+    return _find == &findAVX2 ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -1,20 +1,30 @@
 #include "RequestHandler.hpp"
 
-RequestHandler::RequestHandler(ServerConfig &config, HTTPParser& req, HTTPResponse& resp, FdManager &fdManager):
+RequestHandler::RequestHandler(const ServerConfigPtr &config, HTTPParser& req, HTTPResponse& resp, FdManager &fdManager, EventHandler *owner):
     _router(config),
     _request(req),
     _response(resp),
-    _cgi(_request,_response,config,fdManager),
+    _config(config),
+    _fdManager(fdManager),
+    _cgi(NULL),
+    _owner(owner),
     _cgiSrtartTime(0),
     _keepAlive(false),
     _isCGI(false),
     _isDirSet(false),
+    _putFd(-1),
+    _putCreated(false),
     responseStarted(false)
-{}
+{
+    _request.setHeaderLimits(config->headerBufferSize, config->largeHeaderBufferSize,
+                             std::max(config->headerBufferSize, config->largeHeaderBuffers * config->largeHeaderBufferSize));
+}
 RequestHandler::~RequestHandler() 
 { 
     Logger logger;
     logger.debug("RequestHandler destructor called");
+    _abortPUT();
+    delete _cgi;
     //reset(); 
 }
 
@@ -26,7 +36,7 @@ bool    RequestHandler::isResComplete()
 { 
     // If CGI is running, response is not complete yet
     //logger.debug("Checking if response is complete");
-     if (_isCGI && _cgi.isRunning())
+     if (_isCGI && _cgi && _cgi->isRunning())
      {
          //logger.debug("Response not complete: CGI still running");
          return false;
@@ -35,33 +45,42 @@ bool    RequestHandler::isResComplete()
 }
 bool    RequestHandler::isError() { return _request.isError(); }
 
-size_t  RequestHandler::readNextChunk(char *buff, size_t size)
+// the script reads its stdin slower than the client uploads
+bool    RequestHandler::inputThrottled()
+{
+    return _isCGI && _cgi && _cgi->isRunning() && _request.getBody().size() >= CGI_HIGH_WATER;
+}
+
+bool    RequestHandler::responsePending()
+{
+    return _response.pending() > 0 || (_cgi && _cgi->outputHandedOff());
+}
+size_t  RequestHandler::responseUnsent() { return _response.unsent(); }
+
+bool    RequestHandler::inputDrained()
+{
+    return _request.getBody().size() <= CGI_LOW_WATER;
+}
+
+void    RequestHandler::outputDrained()
+{
+    if (_cgi)
+        _cgi->outputDrained();
+}
+
+ssize_t RequestHandler::sendTo(int fd)
 {
-    const RouteMatch& match = _router.match(_request.getUri(), _request.getMethod());
-	//logger.debug("cgi timeout: " + intToString(match.location->cgi_timeout));
-    //logger.debug("time diff: " + intToString(static_cast<int>(difftime(time(NULL), _cgiSrtartTime))));
-    //logger.debug("time now: " + intToString(static_cast<int>(time(NULL))));
-    //logger.debug("cgi start time: " + intToString(static_cast<int>(_cgiSrtartTime)));
-    // if (_isCGI && difftime(time(NULL), _cgiSrtartTime) >= match.location->cgi_timeout)
-	// {
-    //     _cgi.end();
-    //     logger.error("CGI timeout reached for script: " + match.scriptPath);
-    //     logger.debug("responseStarted: " + std::string(responseStarted ? "true" : "false"));
-    //     if (responseStarted == false)
-    //     {
-    //         _sendErrorResponse(504);
-    //     }
-    //     else 
-	// 	    return (-1);
-	// }
-    if (_isCGI && _cgi.getStatus() != 0)
+    if (_isCGI && _cgi && _cgi->getStatus() != 0)
     {
         if (responseStarted == false)
-            _sendErrorResponse(_cgi.getStatus());
-        else 
+            _sendErrorResponse(_cgi->getStatus());
+        else
+        {
+            errno = EIO; // the status line is gone, all that is left is to cut the connection
             return (-1);
+        }
     }
-    return _response.readNextChunk(buff, size);
+    return _response.sendTo(fd);
 }
 
 void    RequestHandler::reset()
@@ -71,24 +90,34 @@ void    RequestHandler::reset()
     _request.reset();
     _response.reset();
     _isDirSet = false;
-    _cgi.reset();
+    _abortPUT();
+    delete _cgi;
+    _cgi = NULL;
 }
 
 bool    RequestHandler::keepAlive()
 {
-    std::string conn = _request.getHeader("connection");
-    std::transform(conn.begin(), conn.end(), conn.begin(), ::tolower);
+    StrView conn = _request.getHeader(HDR_CONNECTION);
 
-    if (_request.getVers() == "HTTP/1.1")
-        return conn != "close";
-    return conn == "keep-alive";
+    if (_request.getVersionId() == HTTP_11)
+        return !conn.iequals("close");
+    return conn.iequals("keep-alive");
 }
 
 bool    RequestHandler::processRequest()
 {
     _keepAlive = keepAlive();
 
-    const RouteMatch& match = _router.match(_request.getUri(), _request.getMethod());
+    HttpMethod method = _request.getMethodId();
+    _response.setHeadOnly(method == METHOD_HEAD);
+    if (method == METHOD_UNKNOWN)
+    {
+        logger.error("Method not implemented: " + _request.getMethod());
+        _sendErrorResponse(501);
+        return true;
+    }
+
+    const RouteMatch& match = _router.match(_request.getUri(), method);
     
     if (!match.isValidMatch())
     {
@@ -99,21 +128,22 @@ bool    RequestHandler::processRequest()
     if (!match.methodAllowed)
     {
         logger.error("Method not allowed: " + _request.getMethod());
-        _sendErrorResponse(405);
+        _sendErrorResponse(405, match.location);
         return true;
     }
 
     _isCGI = match.isCGI;
-    const std::string& method = _request.getMethod();
-    logger.debug("rquest method : " + method);
-    if (method == "GET")
-        _handleGET(match);
-    else if (method == "POST")
-        _handlePOST(match);
-    else if (method == "DELETE")
-        _handleDELETE(match);
-    else
-        _sendErrorResponse(501);
+    logger.debug("rquest method : " + _request.getMethod());
+    switch (method)
+    {
+    case METHOD_GET:
+    case METHOD_HEAD:       _handleGET(match); break;
+    case METHOD_POST:       _handlePOST(match); break;
+    case METHOD_PUT:        _handlePUT(match); break;
+    case METHOD_DELETE:     _handleDELETE(match); break;
+    case METHOD_OPTIONS:    _handleOPTIONS(match); break;
+    default:                _sendErrorResponse(501); break;
+    }
 
     return _request.isComplete();
 }
@@ -248,10 +278,100 @@ void    RequestHandler::_handleDELETE(const RouteMatch& match)
         _sendErrorResponse(403);
 }
 
-void    RequestHandler::_sendErrorResponse(int code)
+void    RequestHandler::_handlePUT(const RouteMatch& match)
+{
+    if (_isCGI)
+    {
+        _handleCGI(match);
+        return;
+    }
+    // a chunked body grows with every chunk, check it on each call
+    if (_request.getBodySize() > match.maxBodySize)
+    {
+        logger.error("max body size reached");
+        _abortPUT();
+        _sendErrorResponse(413);
+        _request.forceError();
+        return;
+    }
+    if (_putFd == -1)
+    {
+        if (match.isDirectory)
+        {
+            _sendErrorResponse(409);
+            _request.forceError();
+            return;
+        }
+        std::vector<char> path(match.fsPath.begin(), match.fsPath.end());
+        const char suffix[] = ".XXXXXX";
+        path.insert(path.end(), suffix, suffix + sizeof(suffix));
+        _putFd = mkstemp(&path[0]);
+        if (_putFd == -1)
+        {
+            logger.error("cant create file for: " + match.fsPath);
+            _sendErrorResponse(errno == ENOENT || errno == ENOTDIR ? 409 : 403);
+            _request.forceError();
+            return;
+        }
+        fchmod(_putFd, 0644);
+        _putTemp = &path[0];
+        _putCreated = !match.doesExist;
+    }
+
+    BufferChain& body = _request.getBody();
+    while (!body.empty())
+    {
+        if (body.writeTo(_putFd) <= 0)
+        {
+            logger.error("cant write file: " + _putTemp);
+            _abortPUT();
+            _sendErrorResponse(500);
+            _request.forceError();
+            return;
+        }
+    }
+    if (!_request.isComplete())
+        return;
+
+    close(_putFd);
+    _putFd = -1;
+    if (rename(_putTemp.c_str(), match.fsPath.c_str()) == -1)
+    {
+        logger.error("cant replace file: " + match.fsPath);
+        _abortPUT();
+        _sendErrorResponse(500);
+        return;
+    }
+    _putTemp.clear();
+    _response.startLine(_putCreated ? 201 : 204);
+    if (_putCreated)
+        _response.addHeader("content-length", "0");
+    _response.endHeaders();
+}
+
+void    RequestHandler::_abortPUT()
+{
+    if (_putFd != -1)
+        close(_putFd);
+    _putFd = -1;
+    if (!_putTemp.empty())
+        unlink(_putTemp.c_str());
+    _putTemp.clear();
+}
+
+void    RequestHandler::_handleOPTIONS(const RouteMatch& match)
+{
+    _response.startLine(204);
+    _response.addHeader("Allow", _router.getAllowedMethodsStr(*match.location));
+    _response.endHeaders();
+}
+
+void    RequestHandler::_sendErrorResponse(int code, const Location *allow)
 {
     _response.reset();
     _response.startLine(code);
+    if (allow)
+        _response.addHeader("Allow", _router.getAllowedMethodsStr(*allow));
     if (!_response.attachFile(_router.getErrorPage(code)))
         _response.setBody(getErrorPage(code));
 }
@@ -427,7 +547,14 @@ void    RequestHandler::_handleCGI(const RouteMatch& match)
     // run the script, see RouteMatch for more info.. etc
     logger.debug("cgi start is called");
     _cgiSrtartTime = time(NULL);
-    _cgi.start(match, _request.hasBody());
+    if (_cgi && _cgi->isRunning())
+    {
+        _cgi->bodyAvailable();
+        return;
+    }
+    if (!_cgi)
+        _cgi = new CGIHandler(_request, _response, _config, _fdManager, _owner);
+    _cgi->start(match, _request.hasBody());
 }
 
 void    RequestHandler::setError(int code) { _sendErrorResponse(code); }
@@ -1,11 +1,22 @@
 #include "Response.hpp"
+#include <algorithm>
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 HTTPResponse::HTTPResponse(const std::string& version):
     _version(version),
-    _response(BUFF_SIZE * 2),
+    _response(),
     _file_fd(-1),
     _file_size(0),
-    _bytes_sent(0)
+    _file_offset(0),
+    _sendfile(false),
+    _corked(false),
+    _pipe_fd(-1),
+    _chunkLeft(0),
+    _headOnly(false)
 {}
 
 HTTPResponse::~HTTPResponse()
@@ -16,11 +27,11 @@ HTTPResponse::~HTTPResponse()
 void    HTTPResponse::addHeader(const std::string& k, const std::string& v)
 {
     std::string line = k + ": " + v + CRLF;
-    _response.write(line.data(), line.length());
+    _response.append(line.data(), line.length());
 }
 void    HTTPResponse::endHeaders()
 {
-    _response.write(CRLF, 2);
+    _response.append(CRLF, 2);
 }
 
 void    HTTPResponse::setBody(const std::string& data, const std::string& type)
@@ -28,7 +39,8 @@ void    HTTPResponse::setBody(const std::string& data, const std::string& type)
     addHeader("content-type", type);
     addHeader("content-length", SSTR(data.length()));
     endHeaders();
-    _response.write(data.data(), data.length());
+    if (!_headOnly)
+        _response.append(data.data(), data.length());
 }
 
 bool    HTTPResponse::attachFile(const std::string& filepath) {
@@ -41,9 +53,13 @@ bool    HTTPResponse::attachFile(const std::string& filepath) {
         return false;
 
     _file_size = f.st_size;
+    // a small file is cheaper copied behind the headers, one writev instead of writev + sendfile
+    _sendfile = S_ISREG(f.st_mode) && _file_size > SEND_WINDOW;
     addHeader("Content-type", _getContentType(filepath));
     addHeader("Content-Length", SSTR(_file_size));
     endHeaders();
+    if (_headOnly)
+        closeFile();
     
     return true;
 }
@@ -54,36 +70,132 @@ void    HTTPResponse::closeFile()
         ::close(_file_fd);
         _file_fd = -1;
         _file_size = 0;
-        _bytes_sent = 0;
+        _file_offset = 0;
+        _sendfile = false;
     }
 }
 
-ssize_t HTTPResponse::readNextChunk(char* buff, size_t size)
+// tops the queue up to SEND_WINDOW with the next part of the file
+bool    HTTPResponse::_fillFromFile()
 {
-    if (!size || !buff) 
-        return 0;
+    while (_file_offset < _file_size && _response.size() < SEND_WINDOW)
+    {
+        ssize_t bytes = _response.readFrom(_file_fd, std::min(_file_size - _file_offset, SEND_WINDOW - _response.size()));
+        if (bytes <= 0)
+        {
+            // the file shrank under us, the promised content-length can not be met
+            if (bytes == 0)
+                errno = EIO;
+            return false;
+        }
+        _file_offset += bytes;
+    }
+    if (_file_offset == _file_size)
+        closeFile();
+    return true;
+}
 
-    // Send from the in-memory response buffer first
-    size_t toSend = _response.read(buff, size);
-    if (toSend)
-        return toSend;
+ssize_t HTTPResponse::sendTo(int fd)
+{
+    if (_sendfile)
+        return _sendFile(fd);
+    if (_pipe_fd != -1)
+        return _sendPipe(fd);
+    if (_file_fd != -1 && !_fillFromFile())
+        return -1;
+    return _response.writeTo(fd);
+}
 
-    if (_file_fd == -1)
-        return 0;
+void    HTTPResponse::spliceFrom(int pipe_fd)
+{
+    _pipe_fd = pipe_fd;
+    _chunkLeft = 0;
+}
 
-    // If the entire file has been sent, we're done
-    if (_bytes_sent >= _file_size)
+// whatever is buffered, then the pipe content as one chunk: the size line is written
+// from _response, the bytes move pipe -> socket inside the kernel, the CRLF follows.
+// A partial splice keeps the rest of the chunk in the pipe, _chunkLeft tracks it
+ssize_t HTTPResponse::_sendPipe(int fd)
+{
+    ssize_t written = 0;
+    if (!_response.empty())
     {
-        closeFile();
-        return 0;
+        written = _response.writeTo(fd);
+        if (!_response.empty())
+            return written;
+    }
+    if (!_chunkLeft)
+    {
+        int available = 0;
+        if (ioctl(_pipe_fd, FIONREAD, &available) == -1 || available <= 0)
+            return written;
+        _chunkLeft = available;
+        _appendChunkSize(_chunkLeft);
+        ssize_t framing = _response.writeTo(fd);
+        if (framing > 0)
+            written += framing;
+        if (!_response.empty())
+            return written ? written : framing;
     }
 
-    // read from the file
-    ssize_t bytes = ::read(_file_fd, buff, size);
-    if (bytes > 0)
-        _bytes_sent += bytes;
+    ssize_t moved = ::splice(_pipe_fd, NULL, fd, NULL, _chunkLeft, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (moved <= 0)
+        return written ? written : moved;
+    _chunkLeft -= moved;
+    written += moved;
+    if (!_chunkLeft)
+    {
+        _response.append(CRLF, 2);
+        ssize_t framing = _response.writeTo(fd);
+        if (framing > 0)
+            written += framing;
+    }
+    return written;
+}
+
+void    HTTPResponse::_cork(int fd, bool on)
+{
+    int value = on;
+    // not a TCP socket (a unix socket in tests): nothing to coalesce, ignore
+    setsockopt(fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+    _corked = on;
+}
+
+// headers from _response, then the file straight from the page cache by offset.
+// A partial header write resumes from _response, a partial sendfile from _file_offset
+ssize_t HTTPResponse::_sendFile(int fd)
+{
+    ssize_t headers = 0;
+    if (!_response.empty())
+    {
+        if (!_corked)
+            _cork(fd, true);
+        headers = _response.writeTo(fd);
+        if (!_response.empty())
+            return headers;
+    }
 
-    return bytes; // could be number of bytes read or -1 on error
+    off_t offset = _file_offset;
+    ssize_t sent = ::sendfile(fd, _file_fd, &offset, std::min(_file_size - _file_offset, static_cast<size_t>(SENDFILE_CHUNK)));
+    int error = errno;
+    // uncorking pushes the headers and the first file pages out as full segments
+    if (_corked)
+        _cork(fd, false);
+    if (sent == 0)
+    {
+        // the file shrank under us, the promised content-length can not be met
+        errno = EIO;
+        return -1;
+    }
+    if (sent < 0)
+    {
+        errno = error;
+        return headers ? headers : -1;
+    }
+    _file_offset += sent;
+    if (_file_offset == _file_size)
+        closeFile();
+    return headers + sent;
 }
 
 bool    HTTPResponse::isComplete() const
@@ -91,29 +203,40 @@ bool    HTTPResponse::isComplete() const
     Logger logger;
     // if (_cgiComplete)
     //     return true;
-    if (_response.getSize())
+    if (!_response.empty())
     {
         logger.debug("Response not complete: no response data");
         return false;
     }
-    if (_file_size != _bytes_sent)
+    if (_file_size != _file_offset)
     {
         logger.debug("Response not complete: file size mismatch");
         return false;
     }
+    if (_pipe_fd != -1)
+        return false;
     return true;
 }
 
+size_t  HTTPResponse::pending() const { return _response.size(); }
+size_t  HTTPResponse::unsent() const { return _response.size() + (_file_size - _file_offset) + _chunkLeft; }
+
 void    HTTPResponse::reset()
 {
     _response.clear();
     closeFile();
+    _corked = false;
+    _pipe_fd = -1;
+    _chunkLeft = 0;
 }
 
+void    HTTPResponse::setHeadOnly(bool on) { _headOnly = on; }
+bool    HTTPResponse::isHeadOnly() const { return _headOnly; }
+
 void    HTTPResponse::startLine(int code)
 {
     std::string line = _version + ' ' + SSTR(code) + ' ' + _getStatus(code) + CRLF;
-    _response.write(line.data(), line.length());
+    _response.append(line.data(), line.length());
 }
 
 const std::string HTTPResponse::_getContentType(const std::string &filepath)
@@ -232,26 +355,44 @@ const std::string HTTPResponse::_getStatus(int code)
     }
 }
 
-void    HTTPResponse::feedRAW(const char* data, size_t size)
+// hex size line of a chunk, formatted without a stream
+void    HTTPResponse::_appendChunkSize(size_t size)
 {
-    std::stringstream ss;
-    ss << std::hex << size;
-    std::string sizeStr = ss.str();
+    static const char digits[] = "0123456789abcdef";
+    char line[sizeof(size_t) * 2 + 2];
+    size_t pos = sizeof(line) - 2;
+
+    line[pos] = '\r';
+    line[pos + 1] = '\n';
+    do
+    {
+        line[--pos] = digits[size & 0xf];
+        size >>= 4;
+    } while (size);
+    _response.append(line + pos, sizeof(line) - pos);
+}
 
-    _response.write(sizeStr.data(), sizeStr.size());
-    _response.write(CRLF, 2);
-    _response.write(data, size);
-    _response.write(CRLF, 2); 
+void    HTTPResponse::feedRAW(const char* data, size_t size)
+{
+    if (_headOnly)
+        return;
+    _appendChunkSize(size);
+    _response.append(data, size);
+    _response.append(CRLF, 2); 
+}
+void    HTTPResponse::feedRAW(BufferChain& data)
+{
+    if (_headOnly)
+    {
+        data.clear();
+        return;
+    }
+    _appendChunkSize(data.size());
+    _response.splice(data);
+    _response.append(CRLF, 2);
 }
 void    HTTPResponse::feedRAW(const std::string& data)
 {
-    std::stringstream ss;
-    ss << std::hex << data.size();
-    std::string sizeStr = ss.str();
-
-    _response.write(sizeStr.data(), sizeStr.size());
-    _response.write(CRLF, 2);
-    _response.write(data.data(), data.size());
-    _response.write(CRLF, 2);
+    feedRAW(data.data(), data.size());
 }
 
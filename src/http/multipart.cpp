@@ -2,7 +2,7 @@
 #include <iostream>
 #include <cstdio>
 
-Multipart::Multipart(RingBuffer& body):
+Multipart::Multipart(BufferChain& body):
     _state(ST_SEEKBOUND),
     _buff(body)
 { }
@@ -58,13 +58,13 @@ void    Multipart::_seekBound()
     if (!str) // advace the read 
     {
         if (s > _str_boundry.size())
-            _buff.advanceRead(s - _str_boundry.size());
+            _buff.consume(s - _str_boundry.size());
         return;
     }
 
     // this equation came from an example like:
     // "     ---------testfoo" CRLF
-    _buff.advanceRead(_str_boundry.size() + (str - _tmp_buff));
+    _buff.consume(_str_boundry.size() + (str - _tmp_buff));
 
     s = _buff.peek(_tmp_buff, 2); // i just want to check the end bound
     if (s >= 2 && !std::strncmp(_tmp_buff, "--", 2))
@@ -75,7 +75,7 @@ void    Multipart::_seekBound()
     }
 
     if (s >= 2 && !std::strncmp(_tmp_buff, CRLF, 2))
-        _buff.advanceRead(2);
+        _buff.consume(2);
     _state = ST_HEADERS;
 }
 void    Multipart::_parseHeaders()
@@ -88,7 +88,7 @@ void    Multipart::_parseHeaders()
     char *str = std::strstr(_tmp_buff, bound);
     if (!str) return;
 
-    _buff.advanceRead(std::strlen(bound) + (str - _tmp_buff));
+    _buff.consume(std::strlen(bound) + (str - _tmp_buff));
     _state = ST_DATA;
 
     // we take only the headers
@@ -144,11 +144,11 @@ void    Multipart::_parseData()
     // means the bound was found
     if (bound != _tmp_buff + s)
     {
-        _buff.advanceRead(bound - _tmp_buff);
+        _buff.consume(bound - _tmp_buff);
         _state = ST_SAVEPART;
     }
     else
-        _buff.advanceRead(s);
+        _buff.consume(s);
     
     _handleBody(bound - _tmp_buff);
 }
@@ -167,7 +167,7 @@ void    Multipart::_handleBody(size_t size)
         }
         return;
     }
-    _part.body.write(_tmp_buff, size);
+    _part.body.append(_tmp_buff, size);
 }
 
 void    Multipart::_onError()
@@ -1,18 +1,39 @@
 #include <csignal>
 
-#include "EventLoop.hpp"
-#include "Server.hpp"
+#include "Master.hpp"
+#include "ConfigStore.hpp"
+#include "Upgrade.hpp"
+#include "BufferPool.hpp"
+#include "Waker.hpp"
+#include "HTTPScan.hpp"
 
 std::string intToString(int value);
 
-volatile sig_atomic_t g_shutdown = 0;
+volatile sig_atomic_t g_shutdown = 0; // 1: drain and stop, 2: stop now
+volatile sig_atomic_t g_reload = 0;
+volatile sig_atomic_t g_upgrade = 0;
+volatile sig_atomic_t g_wakeFd = -1; // Waker of the process' only event loop, -1 in thread and master mode
 
 void signal_handler(int signal)
 {
-    if (signal != SIGINT && signal != SIGTERM)
+    if (signal == SIGHUP)
+        g_reload = 1;
+    else if (signal == SIGUSR2)
+        g_upgrade = 1;
+    else if (signal != SIGINT && signal != SIGTERM)
         return;
-    std::cout << "\nReceived shutdown signal. Stopping server..." << std::endl;
-    g_shutdown = 1;
+    else if (g_shutdown)
+    {
+        std::cout << "\nReceived second shutdown signal. Closing remaining connections..." << std::endl;
+        g_shutdown = 2;
+    }
+    else
+    {
+        std::cout << "\nReceived shutdown signal. Finishing in-flight requests..." << std::endl;
+        g_shutdown = 1;
+    }
+    if (g_wakeFd != -1)
+        Waker::wake(g_wakeFd);
 }
 
 void setup_signal_handlers()
@@ -28,6 +49,12 @@ void setup_signal_handlers()
     if (sigaction(SIGTERM, &sa, NULL) == -1)
         throw std::runtime_error("Failed to setup SIGTERM handler");
 
+    if (sigaction(SIGHUP, &sa, NULL) == -1)
+        throw std::runtime_error("Failed to setup SIGHUP handler");
+
+    if (sigaction(SIGUSR2, &sa, NULL) == -1)
+        throw std::runtime_error("Failed to setup SIGUSR2 handler");
+
     signal(SIGPIPE, SIG_IGN);
 }
 
@@ -41,22 +68,18 @@ int main(int ac, char **av)
 
     try
     {
+        Upgrade::init(av[0], av[1]);
         WebConfigFile config(av[1]);
 
         Logger logger;
-        EventLoop eventLoop;
-        std::vector<ServerConfig> servers = config.getServers();
-
-        std::vector<Server *> serverInstances;
-
-        for (std::vector<ServerConfig>::iterator it = servers.begin(); it != servers.end(); ++it)
-        {
-            Server *server = new Server(*it, eventLoop.fd_manager);
-            serverInstances.push_back(server);
-            eventLoop.fd_manager.add(server->get_fd(), server, EPOLLIN, false);
-            logger.info("Configured server: " + it->name + " on " + it->host + ":" + intToString(it->port));
-        }
-        logger.info("Starting webserver...");
+        std::vector<ServerConfig> &servers = config.getServers();
+        size_t nworkers = config.getWorkerThreads();
+        FdManager::setConnectionLimit(config.getMaxConnections());
+        EventLoop::setShutdownTimeout(config.getShutdownTimeout());
+        BufferPool::setBudget(config.getBufferPoolSize());
+        ConfigStore::init(av[1], config);
+        // picks the parser kernels before any worker thread can race on the first call
+        logger.debug(std::string("Parser scan kernel: ") + HTTPScan::kernel());
 
         setup_signal_handlers();
         logger.info("Signal handlers configured");
@@ -65,9 +88,64 @@ int main(int ac, char **av)
         std::cout << "Press Ctrl+C to stop the server gracefully" << std::endl;
         std::cout << "Listening for connections..." << std::endl;
 
-        logger.info("Starting event loop");
-        eventLoop.run();
-        logger.info("Event loop exited");
+        if (config.getWorkerProcesses() > 1)
+        {
+            Master master(servers, config.getWorkerProcesses());
+            master.run();
+        }
+        else if (nworkers <= 1)
+        {
+            Worker worker(servers, false);
+            worker.run();
+            BufferPool::logStats();
+            BufferPool::trim();
+        }
+        else
+        {
+            // workers inherit this mask, so SIGINT/SIGTERM/SIGHUP/SIGUSR2 always land on the main thread
+            sigset_t blocked, previous;
+            sigemptyset(&blocked);
+            sigaddset(&blocked, SIGINT);
+            sigaddset(&blocked, SIGTERM);
+            sigaddset(&blocked, SIGHUP);
+            sigaddset(&blocked, SIGUSR2);
+            pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+
+            std::vector<Worker *> workers;
+            for (size_t i = 0; i < nworkers && !g_shutdown; ++i)
+            {
+                workers.push_back(new Worker(servers, true));
+                workers.back()->start();
+            }
+            logger.info("Started " + intToString(workers.size()) + " worker threads");
+            Upgrade::ready();
+
+            while (!g_shutdown)
+            {
+                sigsuspend(&previous);
+                // parse once here, then wake the loops so they pick up the new generation
+                if (g_reload)
+                {
+                    ConfigStore::refresh();
+                    for (size_t i = 0; i < workers.size(); ++i)
+                        workers[i]->wake();
+                }
+                // every thread owns its own SO_REUSEPORT listeners: connections queued on them would be
+                // reset when we drain, so there is no upgrade without dropping any in this mode
+                if (g_upgrade && !g_shutdown)
+                {
+                    g_upgrade = 0;
+                    logger.error("Binary upgrade refused: not supported with worker_threads > 1, use worker_processes or restart");
+                }
+            }
+            pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+            for (size_t i = 0; i < workers.size(); ++i)
+                delete workers[i];
+            logger.info("All workers stopped");
+            BufferPool::logStats();
+            BufferPool::trim();
+        }
     }
     catch (const std::exception &e)
     {
@@ -1,4 +1,5 @@
 #include "Client.hpp"
+#include <cerrno>
 
 std::string intToString(int value)
 {
@@ -7,35 +8,70 @@ std::string intToString(int value)
     return oss.str();
 }
 
-Client::Client(int socket_fd, ServerConfig &config, FdManager &fdm) : EventHandler(config, fdm, time(NULL) + DEFAULT_CLIENT_TIMEOUT),
-                                                                      _socket(socket_fd),
-                                                                      _resp("HTTP/1.1"),
-                                                                      _handler(config, _req, _resp, fdm),
-                                                                      _strFD(intToString(socket_fd)),
-                                                                      _state(ST_READING)
+Transaction::Transaction(const ServerConfigPtr &config, FdManager &fdm, EventHandler *owner)
+    : resp("HTTP/1.1"),
+      handler(config, req, resp, fdm, owner)
 {
-    _socket.set_non_blocking();
+}
+
+Client::Client(int socket_fd, const ServerConfigPtr &config, FdManager &fdm, const sharedPtr<ConnectionStats> &serverConnections)
+    : EventHandler(config, fdm, Timer::now() + config->client_timeout),
+      _strFD(intToString(socket_fd)),
+      _socket(socket_fd),
+      _tx(NULL),
+      _state(ST_READING),
+      _keepAlive(false),
+      _idle(false),
+      _edgeTriggered(config->edgeTriggered),
+      _wouldBlock(false),
+      _inputPaused(false),
+      _ioBytes(0),
+      _bytesSent(0),
+      _serverConnections(serverConnections)
+{
+    _serverConnections->opened();
+    _fd_manager.connectionOpened();
 }
 Client::~Client()
 {
     Logger logger;
     logger.info("Client destructor called for fd: " + _strFD);
+    // the response is the connection's outbound queue, whatever is still in it is lost now
+    size_t unsent = _tx ? _tx->handler.responseUnsent() : 0;
+    _fd_manager.outbound().dropped += unsent;
+    logger.debug("fd " + _strFD + ": " + SSTR(_bytesSent) + " bytes sent, " + SSTR(unsent) + " unsent");
+    delete _tx;
+    _serverConnections->current--;
+    _fd_manager.connectionClosed();
 }
 
 int Client::get_fd() const { return _socket.get_fd(); }
 
 void Client::onEvent(uint32_t events)
 {
-    _updateExpiresAt(time(NULL) + DEFAULT_CLIENT_TIMEOUT);
+    // closing the connection destroys this client, so after each half only the
+    // locals are safe to touch until the fd manager says we are still registered
+    FdManager &fdm = _fd_manager;
+    int fd = get_fd();
+
+    _updateExpiresAt(Timer::now() + _config->client_timeout);
     if (IS_ERROR_EVENT(events))
     {
         onError();
         return;
     }
     if (IS_READ_EVENT(events))
+    {
         onReadable();
+        if (fdm.getOwner(fd) != this)
+            return;
+    }
     if (IS_WRITE_EVENT(events))
+    {
         onWritable();
+        if (fdm.getOwner(fd) != this)
+            return;
+    }
     if (IS_TIMEOUT_EVENT(events))
         onTimeout();
 }
@@ -47,57 +83,99 @@ void Client::onError()
 }
 void Client::onReadable()
 {
-    _readData();
-    switch (_state)
-    {
-    case ST_READING:
-        break;
-    case ST_PROCESSING:
-        _processRequest();
-        break;
-    case ST_PARSEERROR:
-        _processError();
-        break;
-    case ST_ERROR:
-        _processError();
-        break;
-    case ST_CLOSED:
-        _closeConnection();
-        break;
-    default:
-        break;
-    }
+    bool progress;
+
+    _ioBytes = 0;
+    _wouldBlock = false;
+    do
+    {
+        progress = _readData();
+        switch (_state)
+        {
+        case ST_READING:
+            break;
+        case ST_PROCESSING:
+            _processRequest();
+            break;
+        case ST_PARSEERROR:
+            _processError();
+            break;
+        case ST_ERROR:
+            _processError();
+            return;
+        case ST_CLOSED:
+            _closeConnection();
+            return;
+        default:
+            break;
+        }
+    } while (_edgeTriggered && progress && _ioBytes < ET_IO_BUDGET &&
+             (_state == ST_READING || _state == ST_PROCESSING));
+
+    // out of budget with data still queued: no new edge will come, ask for one
+    if (_edgeTriggered && !_wouldBlock && !_inputPaused && (_state == ST_READING || _state == ST_PROCESSING))
+        _fd_manager.retrigger(get_fd());
 }
 void Client::onWritable()
 {
-    _sendData();
-    switch (_state)
-    {
-    case ST_SENDING:
-        break;
-    case ST_ERROR:
-        _processError();
-        break;
-    case ST_SENDCOMPLETE:
-        if (_keepAlive)
-            reset();
-        else
-            _state = ST_CLOSED;
-        break;
-    case ST_CLOSED:
-        _closeConnection();
-        break;
-    default:
-        break;
-    }
+    bool progress;
+
+    _ioBytes = 0;
+    _wouldBlock = false;
+    do
+    {
+        progress = _sendData();
+        switch (_state)
+        {
+        case ST_PROCESSING:
+        case ST_SENDING:
+            break;
+        case ST_ERROR:
+            _processError();
+            return;
+        case ST_SENDCOMPLETE:
+            if (_keepAlive && !_fd_manager.draining())
+                reset();
+            else
+            {
+                _state = ST_CLOSED;
+                _closeConnection();
+                return;
+            }
+            break;
+        case ST_CLOSED:
+            _closeConnection();
+            return;
+        default:
+            break;
+        }
+    } while (_edgeTriggered && progress && _ioBytes < ET_IO_BUDGET &&
+             (_state == ST_SENDING || _state == ST_PROCESSING));
+
+    // the socket still has room (budget spent or the response is waiting on CGI output)
+    if (_edgeTriggered && !_wouldBlock && (_state == ST_SENDING || (_state == ST_PROCESSING && progress)))
+        _fd_manager.retrigger(get_fd());
 }
 
 bool Client::_readData()
 {
     if (_state != ST_READING && _state != ST_PROCESSING)
         return false;
+    if (_state == ST_PROCESSING && _tx && _tx->handler.inputThrottled())
+    {
+        // stop reading until the CGI drained its stdin, resume() picks up from there
+        _inputPaused = true;
+        _fd_manager.modify(this, _processingMask());
+        return false;
+    }
 
-    ssize_t size = _socket.recv(_readBuff, BUFF_SIZE - 1, 0);
+    char *buffer = _fd_manager.ioBuffer();
+    ssize_t size = _socket.recv(buffer, IO_BUFFER_SIZE - 1, 0);
+    if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        _wouldBlock = true;
+        return false;
+    }
     if (size < 0)
     {
         logger.error("Error on client fd: " + _strFD);
@@ -110,62 +188,70 @@ bool Client::_readData()
         _state = ST_CLOSED;
         return false;
     }
-    _readBuff[size] = '\0';
-    _handler.feed(_readBuff, size);
+    _ioBytes += size;
+    _idle = false;
+    buffer[size] = '\0';
+    _handler().feed(buffer, size);
 
-    if (_handler.isError())
+    if (_handler().isError())
     {
         logger.debug("Parsing error on client fd: " + _strFD);
         _state = ST_PARSEERROR;
         return false;
     }
-    if (_handler.isReqHeaderComplete())
+    if (_handler().isReqHeaderComplete())
     {
         logger.info("request processing started: " + _strFD);
         _state = ST_PROCESSING;
-        return false;
     }
 
     return true;
 }
 bool Client::_sendData()
 {
-    if (_state != ST_SENDING)
+    if (_state != ST_SENDING && _state != ST_PROCESSING)
         return false;
 
-    ssize_t toSend = _handler.readNextChunk(_sendBuff, BUFF_SIZE);
-
-    if (toSend < 0)
+    // the response is the outbound queue: sendTo() consumes only what the socket took
+    ssize_t sent = _handler().sendTo(get_fd());
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
     {
-        logger.error("Error on Client fd: " + _strFD);
-        _state = ST_ERROR;
+        _fd_manager.outbound().blocked++;
+        _wouldBlock = true;
         return false;
     }
-    if (toSend == 0)
-    {
-        if (_handler.isResComplete())
-        {
-            logger.debug("Client send response complete fd: " + _strFD);
-            _state = ST_SENDCOMPLETE;
-            return false;
-        }
-        return true;
-    }
-    _handler.responseStarted = true;
-    ssize_t sent = _socket.send(_sendBuff, toSend, 0);
     if (sent < 0)
     {
         logger.error("Can't send data on client fd: " + _strFD);
         _state = ST_ERROR;
         return false;
     }
-    if (sent < toSend)
+    if (sent == 0 && _state == ST_PROCESSING)
+    {
+        // CGI output caught up while the request is still being read
+        _fd_manager.modify(this, _processingMask());
+        return false;
+    }
+    if (sent == 0)
     {
-        logger.warning("Partial send on client fd: " + _strFD);
-        return true;
+        if (_handler().isResComplete())
+        {
+            logger.debug("Client send response complete fd: " + _strFD);
+            _state = ST_SENDCOMPLETE;
+        }
+        else // waiting on the CGI, its next event resumes us instead of a busy EPOLLOUT
+            _fd_manager.modify(this, _mask(0));
+        return false;
     }
+    // a partial write keeps the rest queued, the next call hits EAGAIN if the socket is full
+    _handler().responseStarted = true;
+    _ioBytes += sent;
+    _bytesSent += sent;
+    _fd_manager.outbound().sent += sent;
+    _fd_manager.outbound().writes++;
+    _handler().outputDrained();
 
-    if (_handler.isResComplete())
+    if (_state == ST_SENDING && _handler().isResComplete())
     {
         logger.debug("Sending response complete on client fd: " + _strFD);
         _state = ST_SENDCOMPLETE;
@@ -183,9 +269,12 @@ void Client::_closeConnection()
 
 void Client::reset()
 {
-    _handler.reset();
+    delete _tx;
+    _tx = NULL;
     _state = ST_READING;
-    _fd_manager.modify(this, READ_EVENT);
+    _idle = true;
+    _inputPaused = false;
+    _fd_manager.modify(this, _mask(READ_EVENT));
 }
 
 void Client::_processError()
@@ -195,23 +284,35 @@ void Client::_processError()
         _closeConnection();
         return;
     }
-    _handler.setError(400);
+    _handler().setError(_tx->req.getErrorStatus());
     _state = ST_SENDING;
     _keepAlive = false;
-    _fd_manager.modify(this, WRITE_EVENT);
+    _fd_manager.modify(this, _mask(WRITE_EVENT));
 }
 void Client::_processRequest()
 {
     _keepAlive = _shouldKeepAlive();
-    if (!_handler.processRequest() && !_handler.isError())
+    if (!_handler().processRequest() && !_handler().isError())
         return;
     _state = ST_SENDING;
-    _fd_manager.modify(this, WRITE_EVENT);
+    _fd_manager.modify(this, _mask(WRITE_EVENT));
+}
+
+RequestHandler &Client::_handler()
+{
+    if (!_tx)
+        _tx = new Transaction(_config, _fd_manager, this);
+    return _tx->handler;
+}
+
+uint32_t Client::_mask(uint32_t events)
+{
+    return _edgeTriggered ? events | EPOLLET : events;
 }
 
 bool Client::_shouldKeepAlive()
 {
-    return _handler.keepAlive();
+    return _handler().keepAlive();
 }
 
 int Client::get_fd()
@@ -229,3 +330,34 @@ void Client::onTimeout()
     logger.error("Timeout on client fd: " + _strFD);
     _fd_manager.remove(get_fd());
 }
+
+// graceful shutdown: an idle keep-alive connection is closed now, anything
+// in flight finishes its response and closes instead of being reused
+void Client::onDrain()
+{
+    if (_state == ST_READING && _idle)
+        _closeConnection();
+}
+
+// a CGI exchange is full duplex: while the request body is still being read the
+// script's output is already sent, and each side may be paused on the CGI's water marks
+uint32_t Client::_processingMask()
+{
+    uint32_t events = _inputPaused ? 0 : READ_EVENT;
+    if (_tx && _tx->handler.responsePending())
+        events |= WRITE_EVENT;
+    return _mask(events);
+}
+
+// the CGI handled an event: it may have drained the request body or produced output
+void Client::resume()
+{
+    // a working CGI keeps its client alive even while nothing moves on the socket
+    _updateExpiresAt(Timer::now() + _config->client_timeout);
+    if (_state == ST_SENDING)
+        _fd_manager.modify(this, _mask(WRITE_EVENT));
+    if (_state != ST_PROCESSING || !_tx)
+        return;
+    _inputPaused = _inputPaused && !_tx->handler.inputDrained();
+    _fd_manager.modify(this, _processingMask());
+}
@@ -2,13 +2,11 @@
 #include <sys/epoll.h>
 #include <unistd.h>
 #include <stdexcept>
-#include <signal.h>
-
-extern volatile sig_atomic_t g_shutdown;
+#include <cerrno>
 
 Epoll::Epoll()
 {
-    _epoll_fd = epoll_create1(0);
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (_epoll_fd == -1)
     {
         throw std::runtime_error("Failed to create epoll file descriptor");
@@ -25,15 +23,15 @@ Epoll::~Epoll()
 
 void Epoll::add_fd(Socket &socket, uint32_t events)
 {
-    add_fd(socket.get_fd(), events);
+    add_fd(socket.get_fd(), events, 0);
     socket.register_epoll(this);
 }
 
-void Epoll::add_fd(int fd, uint32_t events)
+void Epoll::add_fd(int fd, uint32_t events, uint32_t generation)
 {
     struct epoll_event event;
     event.events = events;
-    event.data.fd = fd;
+    event.data.u64 = EVENT_DATA(fd, generation);
     if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
     {
         throw std::runtime_error("Failed to add file descriptor to epoll");
@@ -48,11 +46,11 @@ void Epoll::remove_fd(int fd)
     }
 }
 
-void Epoll::modify_fd(int fd, uint32_t events)
+void Epoll::modify_fd(int fd, uint32_t events, uint32_t generation)
 {
     struct epoll_event event;
     event.events = events;
-    event.data.fd = fd;
+    event.data.u64 = EVENT_DATA(fd, generation);
     if (::epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1)
     {
         throw std::runtime_error("Failed to modify file descriptor in epoll");
@@ -61,29 +59,30 @@ void Epoll::modify_fd(int fd, uint32_t events)
 
 void Epoll::modify_fd(Socket &socket, uint32_t events)
 {
-    modify_fd(socket.get_fd(), events);
+    modify_fd(socket.get_fd(), events, 0);
 }
 
-std::vector<epoll_event> Epoll::wait(int timeout)
+EventSpan Epoll::wait(int timeout)
 {
-    std::vector<epoll_event> ready_events;
-    struct epoll_event events[MAX_EVENTS];
-    int num_events = ::epoll_wait(_epoll_fd, events, MAX_EVENTS, timeout);
+    epoll_event *first = _beginBatch();
+
+    int num_events = ::epoll_wait(_epoll_fd, first, _events.size(), timeout);
     if (num_events == -1)
     {
-        if (g_shutdown)
-        {
-            return ready_events;
-        }
-        throw std::runtime_error("Failed to wait for epoll events");
+        // a signal (shutdown, reload, worker wakeup): let the loop look at its flags
+        if (errno != EINTR)
+            throw std::runtime_error("Failed to wait for epoll events");
+        num_events = 0;
     }
 
-    for (int i = 0; i < num_events; i++)
-    {
-        ready_events.push_back(events[i]);
-    }
+    _endBatch(num_events);
+    EventSpan span = {first, first + num_events};
+    return span;
+}
 
-    return ready_events;
+const char *Epoll::name() const
+{
+    return "epoll";
 }
 
 void Epoll::remove_fd(Socket &socket)
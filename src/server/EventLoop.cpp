@@ -1,102 +1,153 @@
 #include "EventLoop.hpp"
+#include "ConfigStore.hpp"
+#include "Upgrade.hpp"
 #include <sstream>
 #include <csignal>
-#include <limits>
 
 #define SSTR(x) static_cast<std::ostringstream &>((std::ostringstream() << x)).str()
 
 extern volatile sig_atomic_t g_shutdown;
+extern volatile sig_atomic_t g_upgrade;
 
-EventLoop::EventLoop() : epoll(), fd_manager(epoll)
+msec_t EventLoop::_shutdownTimeout = 10 * 1000;
+
+EventLoop::EventLoop(Waker &waker) : poller(Poller::create()), timer(), _waker(waker), _generation(ConfigStore::refresh()), _drainDeadline(-1), _upgrades(false), fd_manager(*poller)
 {
+    poller->add_fd(timer.getFd(), EPOLLIN, 0);
+    poller->add_fd(_waker.getFd(), EPOLLIN, 0);
+    logger.info(std::string("Event backend: ") + poller->name());
 }
 
-int EventLoop::computeNextTimeout()
+void EventLoop::setShutdownTimeout(msec_t timeout)
 {
-    std::map<int, EventHandler *> &handlers = fd_manager.getEventHandlersTimeouts();
-    if (handlers.empty())
-        return -1;
+    _shutdownTimeout = timeout;
+}
 
-    time_t now = time(NULL);
-    time_t min_expires = std::numeric_limits<time_t>::max();
+void EventLoop::addListener(EventHandler *server)
+{
+    fd_manager.add(server->get_fd(), server, EPOLLIN, false);
+    _listeners.push_back(server->get_fd());
+}
 
-    for (std::map<int, EventHandler *>::iterator it = handlers.begin(); it != handlers.end(); ++it)
+void EventLoop::handleUpgrades()
+{
+    _upgrades = true;
+}
+
+void EventLoop::armTimer()
+{
+    msec_t deadline = fd_manager.nextDeadline();
+    if (_drainDeadline != -1 && (deadline == -1 || _drainDeadline < deadline))
+        deadline = _drainDeadline;
+    timer.arm(deadline);
+}
+
+// picks up a SIGHUP reload, the listeners hand the new ServerConfig to clients accepted from now on
+void EventLoop::_reload()
+{
+    unsigned generation = ConfigStore::refresh();
+    if (generation == _generation)
+        return;
+    _generation = generation;
+
+    std::vector<ServerConfig> servers = ConfigStore::snapshot();
+    for (size_t i = 0; i < _listeners.size(); ++i)
     {
-        EventHandler *handler = it->second;
-        if (!handler)
-            continue;
-        time_t ex = handler->getExpiresAt();
-        if (ex < min_expires)
-            min_expires = ex;
+        EventHandler *listener = fd_manager.getOwner(_listeners[i]);
+        if (listener)
+            listener->reconfigure(servers);
     }
+}
 
-    if (min_expires <= now)
-        return 0;
-
-    long seconds = static_cast<long>(min_expires - now);
-    long ms = seconds * 1000L;
-    if (ms > std::numeric_limits<int>::max())
-        return std::numeric_limits<int>::max();
-    return static_cast<int>(ms);
+// first shutdown signal: close the listeners, drop idle connections and let the rest finish
+void EventLoop::_startDrain()
+{
+    _drainDeadline = Timer::now() + _shutdownTimeout;
+    for (size_t i = 0; i < _listeners.size(); ++i)
+        fd_manager.remove(_listeners[i]);
+    _listeners.clear();
+    fd_manager.drain();
+    logger.info("Draining " + SSTR(fd_manager.size()) + " connections, shutdown_timeout " + SSTR(_shutdownTimeout) + "ms");
 }
 
 void EventLoop::expireTimeouts()
 {
-    std::map<int, EventHandler *> handlers = fd_manager.getEventHandlersTimeouts();
+    std::vector<TimerEntry> expired;
+    fd_manager.popExpired(Timer::now(), expired);
 
-    for (std::map<int, EventHandler *>::iterator it = handlers.begin(); it != handlers.end(); ++it)
+    for (size_t i = 0; i < expired.size(); ++i)
     {
-        time_t now = time(NULL);
-        EventHandler *handler = it->second;
+        // an earlier timeout in this batch may already have torn this handler down
+        EventHandler *handler = fd_manager.getTimerOwner(expired[i]);
         if (!handler)
             continue;
-        if (handler->getExpiresAt() <= now)
+        try
         {
-            try
-            {
-                handler->onEvent(TIMEOUT_EVENT);
-            }
-            catch (const std::exception &e)
-            {
-                logger.error(std::string("Exception in onEvent(): ") + e.what());
-            }
-            catch (...)
-            {
-                logger.error("Unknown exception in onEvent()");
-            }
+            handler->onEvent(TIMEOUT_EVENT);
+        }
+        catch (const std::exception &e)
+        {
+            logger.error(std::string("Exception in onEvent(): ") + e.what());
+        }
+        catch (...)
+        {
+            logger.error("Unknown exception in onEvent()");
         }
+        fd_manager.rearm(expired[i]);
     }
 }
 
-#define DEFAULT_WAIT 15000
-
 void EventLoop::run()
 {
     logger.info("Event loop started");
-    while (!g_shutdown)
+    // g_shutdown is 1 for a graceful shutdown, 2 (second signal) to stop right away
+    while (g_shutdown < 2)
     {
-        std::vector<epoll_event> events = epoll.wait(DEFAULT_WAIT);
+        if (g_shutdown && _drainDeadline == -1)
+            _startDrain();
+        if (_drainDeadline != -1 && (fd_manager.size() == 0 || Timer::now() >= _drainDeadline))
+            break;
+        if (!g_shutdown)
+            _reload();
+        if (g_upgrade && _upgrades && !g_shutdown)
+        {
+            g_upgrade = 0;
+            Upgrade::spawn(_listeners);
+        }
+        armTimer();
+        EventSpan events = poller->wait(-1);
         expireTimeouts();
-        for (size_t i = 0; i < events.size(); i++)
+        for (epoll_event *event = events.begin(); event != events.end(); ++event)
         {
+            int fd = EVENT_FD(*event);
+            if (fd == timer.getFd())
+            {
+                timer.clear();
+                continue;
+            }
+            // a signal or another thread: the flags are looked at on the next iteration
+            if (fd == _waker.getFd())
+            {
+                _waker.clear();
+                continue;
+            }
             try
             {
-                EventHandler *handler = fd_manager.getOwner(events[i].data.fd);
+                EventHandler *handler = fd_manager.getOwner(fd, EVENT_GEN(*event));
                 if (handler == NULL)
                 {
-                    logger.warning("Event for unknown fd: " + SSTR(events[i].data.fd));
+                    logger.warning("Event for unknown or recycled fd: " + SSTR(fd));
                     continue;
                 }
-                handler->onEvent(events[i].events);
+                handler->onEvent(event->events);
             }
             catch (const std::exception &e)
             {
                 logger.error("Exception in event loop: " + std::string(e.what()));
                 try
                 {
-                    EventHandler *handler = fd_manager.getOwner(events[i].data.fd);
-                    if (handler)
-                        fd_manager.remove(events[i].data.fd);
+                    if (fd_manager.getOwner(fd, EVENT_GEN(*event)))
+                        fd_manager.remove(fd);
                 }
                 catch (...)
                 {
@@ -104,7 +155,29 @@ void EventLoop::run()
                 }
             }
         }
+        fd_manager.resumeListeners();
     }
+    if (fd_manager.size())
+        logger.warning("Closing " + SSTR(fd_manager.size()) + " connections still open at shutdown");
+    logStats();
+}
+
+void EventLoop::logStats()
+{
+    const PollerStats &stats = poller->getStats();
+    unsigned long average = stats.wakeups ? stats.events / stats.wakeups : 0;
+    logger.info(std::string(poller->name()) + " stats: " + SSTR(stats.wakeups) + " wakeups, " + SSTR(stats.events) + " events (avg " + SSTR(average) +
+                ", max " + SSTR(stats.maxBatch) + " per wakeup), " + SSTR(stats.fullBatches) + " full batches, buffer " +
+                SSTR(stats.capacity));
+
+    const ConnectionStats &connections = fd_manager.connections();
+    logger.info("Connection stats: " + SSTR(connections.current) + " open, peak " + SSTR(connections.peak) + ", " +
+                SSTR(connections.shed) + " rejected over max_connections");
+
+    const OutboundStats &outbound = fd_manager.outbound();
+    logger.info("Outbound stats: " + SSTR(outbound.sent) + " bytes sent in " + SSTR(outbound.writes) + " writes, " +
+                SSTR(outbound.blocked) + " found the socket full, " + SSTR(outbound.dropped) +
+                " queued bytes dropped with their connection");
 }
 
 EventLoop::~EventLoop()
@@ -1,76 +1,271 @@
 #include "FdManager.hpp"
+#include <sys/resource.h>
+#include <algorithm>
 
-FdManager::FdManager(Epoll &epoll) : _epoll(epoll) {}
+#define INITIAL_SLOTS 1024
+
+size_t FdManager::_connectionLimit = 0;
+
+FdManager::FdManager(Poller &poller) : _poller(poller), _registered(0), _draining(false), _resumeListeners(false), _ioBuffer(IO_BUFFER_SIZE)
+{
+    ConnectionStats none = {0, 0, 0, _connectionLimit};
+    _connections = none;
+    OutboundStats nothing = {0, 0, 0, 0};
+    _outbound = nothing;
+
+    struct rlimit limit;
+    _maxFds = 65536;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+        _maxFds = limit.rlim_cur;
+
+    FdSlot empty = {NULL, 0, 0, false};
+    _slots.resize(std::min(static_cast<size_t>(INITIAL_SLOTS), _maxFds), empty);
+}
 FdManager::~FdManager()
 {
     Logger logger;
     logger.debug("FdManager destructor called");
-    for (std::map<int, EventHandler *>::iterator it = fd_map.begin(); it != fd_map.end(); ++it)
+    for (size_t fd = 0; fd < _slots.size(); ++fd)
     {
-        logger.debug("Cleaning up fd: " + intToString(it->first));
-        it->second->destroy();
+        EventHandler *handler = _slots[fd].handler;
+        if (!handler)
+            continue;
+        logger.debug("Cleaning up fd: " + intToString(fd));
+        _slots[fd].handler = NULL;
+        handler->destroy();
     }
-    fd_map.clear();
+}
+FdManager::FdSlot *FdManager::_slot(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= _slots.size() || !_slots[fd].handler)
+        return NULL;
+    return &_slots[fd];
 }
 void FdManager::add(int fd, EventHandler *handler, int events, bool timeout)
 {
-    _epoll.add_fd(fd, events);
-    fd_map[fd] = handler;
+    if (fd < 0)
+        throw std::runtime_error("Invalid file descriptor");
+    if (static_cast<size_t>(fd) >= _slots.size())
+    {
+        // fds are allocated lowest-first, so the table stays dense up to the rlimit
+        size_t size = std::max(static_cast<size_t>(fd) + 1, _slots.size() * 2);
+        FdSlot empty = {NULL, 0, 0, false};
+        _slots.resize(std::max(std::min(size, _maxFds), static_cast<size_t>(fd) + 1), empty);
+    }
+
+    FdSlot &slot = _slots[fd];
+    slot.generation++;
+    _poller.add_fd(fd, events, slot.generation);
+    slot.handler = handler;
+    slot.events = events;
+    slot.timeout = timeout;
+    _registered++;
     if (timeout)
-        timeout_map[fd] = handler;
+    {
+        TimerEntry entry;
+        entry.expires = handler->getExpiresAt();
+        entry.fd = fd;
+        entry.generation = slot.generation;
+        _timers.push(entry);
+    }
 }
 void FdManager::remove(int fd)
 {
     Logger logger;
     logger.debug("FdManager removing fd: " + intToString(fd));
-    std::map<int, EventHandler *>::iterator it = fd_map.find(fd);
-    if (it != fd_map.end())
+    FdSlot *slot = _slot(fd);
+    if (slot)
     {
-        if (timeout_map.find(fd) != timeout_map.end())
-            timeout_map.erase(fd);
-        _epoll.remove_fd(fd);
-        it->second->destroy();
-        fd_map.erase(it);
+        EventHandler *handler = slot->handler;
+        slot->handler = NULL;
+        slot->timeout = false;
+        _registered--;
+        _poller.remove_fd(fd);
+        handler->destroy();
+        // a listener paused on EMFILE may be able to accept again
+        if (!_pausedListeners.empty())
+            _resumeListeners = true;
     }
 }
 void FdManager::detachFd(int fd)
 {
     Logger logger;
-    std::map<int, EventHandler *>::iterator it = fd_map.find(fd);
-    if (it != fd_map.end())
+    FdSlot *slot = _slot(fd);
+    if (slot)
     {
         logger.debug("FdManager detaching fd: " + intToString(fd));
-        if (timeout_map.find(fd) != timeout_map.end())
-            timeout_map.erase(fd);
-        _epoll.remove_fd(fd);
-        fd_map.erase(it);
+        slot->handler = NULL;
+        slot->timeout = false;
+        _registered--;
+        _poller.remove_fd(fd);
     }
 }
 EventHandler *FdManager::getOwner(int fd)
 {
-    std::map<int, EventHandler *>::iterator it = fd_map.find(fd);
-    if (it != fd_map.end())
-    {
-        return it->second;
-    }
-    return NULL;
+    FdSlot *slot = _slot(fd);
+    return slot ? slot->handler : NULL;
+}
+EventHandler *FdManager::getOwner(int fd, uint32_t generation)
+{
+    FdSlot *slot = _slot(fd);
+    // an older generation means the fd was closed and reused after epoll reported it
+    if (!slot || slot->generation != generation)
+        return NULL;
+    return slot->handler;
 }
 bool FdManager::exists(int fd)
 {
-    return fd_map.find(fd) != fd_map.end();
+    return _slot(fd) != NULL;
 }
 void FdManager::modify(int fd, uint32_t events)
 {
-    if (exists(fd))
+    FdSlot *slot = _slot(fd);
+    if (slot && slot->events != events)
     {
-        _epoll.modify_fd(fd, events);
+        _poller.modify_fd(fd, events, slot->generation);
+        slot->events = events;
     }
 }
 void FdManager::modify(EventHandler *handler, uint32_t events)
 {
     modify(handler->get_fd(), events);
 }
-std::map<int, EventHandler *> &FdManager::getEventHandlersTimeouts()
+void FdManager::retrigger(int fd)
+{
+    // EPOLL_CTL_MOD re-evaluates readiness, so an edge-triggered fd that still
+    // has pending data gets reported again on the next epoll_wait
+    FdSlot *slot = _slot(fd);
+    if (slot)
+        _poller.modify_fd(fd, slot->events, slot->generation);
+}
+size_t FdManager::size() const
+{
+    return _registered;
+}
+
+char *FdManager::ioBuffer()
+{
+    return &_ioBuffer[0];
+}
+void FdManager::drain()
+{
+    _draining = true;
+    // handlers may close themselves (and others) here, slots are re-read on every step
+    for (size_t fd = 0; fd < _slots.size(); ++fd)
+    {
+        if (_slots[fd].handler)
+            _slots[fd].handler->onDrain();
+    }
+}
+bool FdManager::draining() const
+{
+    return _draining;
+}
+EventHandler *FdManager::getTimerOwner(const TimerEntry &entry)
+{
+    FdSlot *slot = _slot(entry.fd);
+    if (!slot || !slot->timeout || slot->generation != entry.generation)
+        return NULL;
+    return slot->handler;
+}
+
+void FdManager::popExpired(msec_t now, std::vector<TimerEntry> &expired)
+{
+    while (!_timers.empty() && _timers.top().expires <= now)
+    {
+        TimerEntry entry = _timers.top();
+        _timers.pop();
+
+        EventHandler *handler = getTimerOwner(entry);
+        if (!handler)
+            continue;
+        msec_t current = handler->getExpiresAt();
+        if (current > entry.expires)
+        {
+            // the handler was re-armed since this entry was pushed
+            entry.expires = current;
+            _timers.push(entry);
+            continue;
+        }
+        expired.push_back(entry);
+    }
+}
+
+void FdManager::rearm(TimerEntry entry)
+{
+    EventHandler *handler = getTimerOwner(entry);
+    if (!handler)
+        return;
+    entry.expires = handler->getExpiresAt();
+    _timers.push(entry);
+}
+
+msec_t FdManager::nextDeadline()
+{
+    while (!_timers.empty())
+    {
+        TimerEntry entry = _timers.top();
+        EventHandler *handler = getTimerOwner(entry);
+        if (handler && handler->getExpiresAt() == entry.expires)
+            return entry.expires;
+        _timers.pop();
+        if (handler)
+            rearm(entry);
+    }
+    return -1;
+}
+
+void FdManager::setConnectionLimit(size_t max)
+{
+    _connectionLimit = max;
+}
+
+ConnectionStats &FdManager::connections()
+{
+    return _connections;
+}
+
+OutboundStats &FdManager::outbound()
+{
+    return _outbound;
+}
+
+void FdManager::connectionOpened()
 {
-    return timeout_map;
-}
\ No newline at end of file
+    _connections.opened();
+}
+
+void FdManager::connectionClosed()
+{
+    _connections.current--;
+    if (!_pausedListeners.empty())
+        _resumeListeners = true;
+}
+
+void FdManager::pauseListener(int fd)
+{
+    FdSlot *slot = _slot(fd);
+    if (!slot || slot->events == 0)
+        return;
+    PausedListener paused = {fd, slot->events, slot->generation};
+    _pausedListeners.push_back(paused);
+    modify(fd, 0);
+}
+
+// a slot freed up: poll every paused listener again, one that is still over its
+// own limit pauses itself on the next readable event
+void FdManager::resumeListeners()
+{
+    if (!_resumeListeners)
+        return;
+    _resumeListeners = false;
+    for (size_t i = 0; i < _pausedListeners.size(); ++i)
+    {
+        // closed while paused (drain, upgrade), the fd may belong to a client or a pipe by now
+        const PausedListener &paused = _pausedListeners[i];
+        FdSlot *slot = _slot(paused.fd);
+        if (slot && slot->generation == paused.generation)
+            modify(paused.fd, paused.events);
+    }
+    _pausedListeners.clear();
+}
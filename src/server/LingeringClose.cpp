@@ -0,0 +1,53 @@
+#include "LingeringClose.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <cerrno>
+
+LingeringClose::LingeringClose(int fd, const ServerConfigPtr &config, FdManager &fdm)
+    : EventHandler(config, fdm, Timer::now() + LINGER_TIMEOUT),
+      _socket(fd)
+{
+}
+
+void LingeringClose::start(int fd, const ServerConfigPtr &config, FdManager &fdm)
+{
+    LingeringClose *closing = NULL;
+    try
+    {
+        closing = new LingeringClose(fd, config, fdm);
+        fdm.add(fd, closing, READ_EVENT);
+    }
+    catch (const std::exception &e)
+    {
+        Logger logger;
+        logger.error("Failed to register closing connection: " + std::string(e.what()));
+        if (closing)
+            delete closing;
+        else
+            close(fd);
+    }
+}
+
+int LingeringClose::get_fd()
+{
+    return _socket.get_fd();
+}
+
+void LingeringClose::destroy()
+{
+    delete this;
+}
+
+void LingeringClose::onEvent(uint32_t events)
+{
+    if (IS_READ_EVENT(events) && !IS_TIMEOUT_EVENT(events))
+    {
+        ssize_t n;
+        while ((n = recv(get_fd(), _fd_manager.ioBuffer(), IO_BUFFER_SIZE, MSG_DONTWAIT)) > 0)
+            ;
+        // the peer is still sending and has not closed its side yet
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && !IS_ERROR_EVENT(events))
+            return;
+    }
+    _fd_manager.remove(get_fd());
+}
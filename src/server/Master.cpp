@@ -0,0 +1,217 @@
+#include "Master.hpp"
+#include "ConfigStore.hpp"
+#include "Upgrade.hpp"
+#include "BufferPool.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cerrno>
+
+extern volatile sig_atomic_t g_shutdown;
+extern volatile sig_atomic_t g_reload;
+extern volatile sig_atomic_t g_upgrade;
+
+std::string intToString(int value);
+
+static void sigchld_handler(int signal)
+{
+    (void)signal;
+}
+
+Master::Master(std::vector<ServerConfig> &servers, size_t nworkers)
+    : _servers(servers), _nworkers(nworkers), _generation(0)
+{
+}
+
+Master::~Master()
+{
+    for (size_t i = 0; i < _listeners.size(); ++i)
+        delete _listeners[i];
+}
+
+void Master::_bindListeners()
+{
+    for (size_t i = 0; i < _servers.size(); ++i)
+    {
+        int inherited = Upgrade::take(_servers[i].host, _servers[i].port);
+        if (inherited != -1)
+        {
+            _listeners.push_back(new Socket(inherited));
+            continue;
+        }
+        Socket *socket = new Socket();
+        _listeners.push_back(socket);
+        Server::listenOn(*socket, _servers[i], false);
+        logger.info("Master listening on " + _servers[i].host + ":" + intToString(_servers[i].port));
+    }
+}
+
+pid_t Master::_spawn(const sigset_t &childMask)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        logger.error("Failed to fork worker process");
+        return pid;
+    }
+    if (pid == 0)
+    {
+        // the worker reaps its own CGI children with waitpid, it must not inherit the master's handler
+        signal(SIGCHLD, SIG_DFL);
+        sigprocmask(SIG_SETMASK, &childMask, NULL);
+
+        std::vector<int> fds;
+        for (size_t i = 0; i < _listeners.size(); ++i)
+            fds.push_back(_listeners[i]->get_fd());
+
+        int code = EXIT_SUCCESS;
+        try
+        {
+            Worker worker(_servers, fds);
+            worker.run();
+            BufferPool::logStats();
+            BufferPool::trim();
+        }
+        catch (const std::exception &e)
+        {
+            logger.error(std::string("Worker process failed: ") + e.what());
+            code = EXIT_FAILURE;
+        }
+        std::exit(code);
+    }
+    _workers[pid] = time(NULL);
+    logger.info("Started worker process " + intToString(pid));
+    return pid;
+}
+
+void Master::_reap(const sigset_t &childMask)
+{
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        std::map<pid_t, time_t>::iterator it = _workers.find(pid);
+        if (it == _workers.end())
+            continue;
+        time_t spawned = it->second;
+        _workers.erase(it);
+
+        if (WIFSIGNALED(status))
+            logger.error("Worker " + intToString(pid) + " killed by signal " + intToString(WTERMSIG(status)));
+        else
+            logger.warning("Worker " + intToString(pid) + " exited with status " + intToString(WEXITSTATUS(status)));
+
+        if (g_shutdown)
+            continue;
+        // a worker that dies right after starting will most likely die again, don't spin on fork
+        if (time(NULL) - spawned < 1)
+            sleep(1);
+        _spawn(childMask);
+    }
+}
+
+void Master::_signalWorkers(int signal)
+{
+    for (std::map<pid_t, time_t>::iterator it = _workers.begin(); it != _workers.end(); ++it)
+        kill(it->first, signal);
+}
+
+// validate the file here first; workers only re-parse it when the master accepted it,
+// and workers forked later start from the new configuration
+void Master::_reload()
+{
+    unsigned generation = ConfigStore::refresh();
+    if (generation == _generation)
+        return;
+    _generation = generation;
+    _servers = ConfigStore::snapshot();
+    _signalWorkers(SIGHUP);
+}
+
+// the new master adopts our sockets and SIGTERMs us once it is up, our workers then drain
+void Master::_upgrade()
+{
+    std::vector<int> fds;
+    for (size_t i = 0; i < _listeners.size(); ++i)
+        fds.push_back(_listeners[i]->get_fd());
+    Upgrade::spawn(fds);
+}
+
+void Master::_stopWorkers()
+{
+    bool forced = false;
+
+    _signalWorkers(SIGTERM);
+    while (!_workers.empty())
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            // a second SIGINT/SIGTERM: make the draining workers stop right away
+            if (errno == EINTR && g_shutdown > 1 && !forced)
+            {
+                _signalWorkers(SIGTERM);
+                forced = true;
+            }
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (_workers.erase(pid))
+            logger.info("Worker " + intToString(pid) + " stopped");
+    }
+}
+
+void Master::run()
+{
+    _bindListeners();
+
+    struct sigaction sa;
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_NOCLDSTOP;
+    if (sigaction(SIGCHLD, &sa, NULL) == -1)
+        throw std::runtime_error("Failed to setup SIGCHLD handler");
+
+    // signals stay blocked outside sigsuspend so none of them can slip in between the checks below
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGHUP);
+    sigaddset(&blocked, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &blocked, &previous);
+
+    // the listeners are bound, an old instance that started us can stop accepting
+    Upgrade::ready();
+
+    _generation = ConfigStore::refresh();
+    for (size_t i = 0; i < _nworkers; ++i)
+        _spawn(previous);
+    logger.info("Master supervising " + intToString(_workers.size()) + " worker processes");
+
+    while (!g_shutdown)
+    {
+        sigsuspend(&previous);
+        if (g_reload)
+            _reload();
+        if (g_upgrade && !g_shutdown)
+        {
+            g_upgrade = 0;
+            _upgrade();
+        }
+        _reap(previous);
+    }
+
+    // the workers close their copies when they start draining, once ours is gone too the kernel refuses new connections
+    for (size_t i = 0; i < _listeners.size(); ++i)
+        delete _listeners[i];
+    _listeners.clear();
+
+    logger.info("Forwarding shutdown to worker processes");
+    sigprocmask(SIG_SETMASK, &previous, NULL);
+    _stopWorkers();
+}
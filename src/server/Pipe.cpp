@@ -1,5 +1,7 @@
 #include "Pipe.hpp"
 #include "Logger.hpp"
+#include <sys/ioctl.h>
+#include <cerrno>
 std::string intToString(int value);
 Pipe::Pipe()
 {
@@ -33,6 +35,14 @@ int Pipe::write_fd() const
     return fd[1];
 }
 
+int Pipe::available() const
+{
+    int bytes = 0;
+    if (fd[0] == -1 || ioctl(fd[0], FIONREAD, &bytes) == -1)
+        return 0;
+    return bytes;
+}
+
 void Pipe::close()
 {
     closeRead();
@@ -42,7 +52,8 @@ void Pipe::close()
 int Pipe::read(char *buffer, size_t size)
 {
     ssize_t bytesRead = ::read(fd[0], buffer, size);
-    if (bytesRead < 0)
+    // non-blocking and empty: the caller decides, -1 with errno EAGAIN
+    if (bytesRead < 0 && errno != EAGAIN)
     {
         throw std::runtime_error("Failed to read from pipe");
     }
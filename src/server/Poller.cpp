@@ -0,0 +1,50 @@
+#include "Poller.hpp"
+#include "Epoll.hpp"
+#include <algorithm>
+
+Poller::Poller() : _events(INITIAL_EVENTS), _lastBatchFull(false)
+{
+    _stats.wakeups = 0;
+    _stats.events = 0;
+    _stats.fullBatches = 0;
+    _stats.maxBatch = 0;
+    _stats.capacity = _events.size();
+}
+
+Poller::~Poller()
+{
+}
+
+epoll_event *Poller::_beginBatch()
+{
+    // the last batch filled the buffer, there is probably more pending than we can take
+    if (_lastBatchFull && _events.size() < MAX_EVENTS)
+    {
+        _events.resize(std::min(_events.size() * 2, static_cast<size_t>(MAX_EVENTS)));
+        _stats.capacity = _events.size();
+    }
+    return &_events[0];
+}
+
+void Poller::_endBatch(size_t count)
+{
+    _lastBatchFull = count == _events.size();
+    if (count == 0)
+        return;
+    _stats.wakeups++;
+    _stats.events += count;
+    if (_lastBatchFull)
+        _stats.fullBatches++;
+    if (count > _stats.maxBatch)
+        _stats.maxBatch = count;
+}
+
+const PollerStats &Poller::getStats() const
+{
+    return _stats;
+}
+
+Poller *Poller::create()
+{
+    return new Epoll();
+}
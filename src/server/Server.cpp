@@ -1,35 +1,93 @@
 #include "../../include/server/Server.hpp"
 #include "../../include/server/Client.hpp"
+#include "LingeringClose.hpp"
 #include "../../include/utils/Logger.hpp"
+#include "SpecialResponse.hpp"
 #include <sstream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/tcp.h>
 
 #define SSTR(x) static_cast<std::ostringstream &>((std::ostringstream() << x)).str()
 
-Server::Server(ServerConfig &config, FdManager &fdm)
-    : EventHandler(config, fdm, -1)
+Server::Server(const ServerConfig &config, FdManager &fdm, bool reusePort)
+    : EventHandler(ServerConfigPtr(new ServerConfig(config)), fdm, -1)
 {
     Logger logger;
 
+    _init();
+    listenOn(_socket, config, reusePort);
+
+    logger.info("Server initialized on " + config.host + ":" + SSTR(config.port));
+}
+
+Server::Server(const ServerConfig &config, FdManager &fdm, int fd, fromFdTag)
+    : EventHandler(ServerConfigPtr(new ServerConfig(config)), fdm, -1),
+      _socket(fd)
+{
+    Logger logger;
+
+    _init();
+    logger.info("Server inherited listener on " + config.host + ":" + SSTR(config.port));
+}
+
+void Server::_init()
+{
+    _reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    _accepted = 0;
+    _shed = 0;
+    _maxBatch = 0;
+    _peakQueue = 0;
+    _pauses = 0;
+
+    ConnectionStats none = {0, 0, 0, _config->maxConnections};
+    _connections = sharedPtr<ConnectionStats>(new ConnectionStats(none));
+    _buildOverloadResponse();
+}
+
+void Server::_buildOverloadResponse()
+{
+    std::string body = getErrorPage(503);
+    _overloadResponse = "HTTP/1.1 503 Service Unavailable\r\n"
+                        "Retry-After: " + SSTR(_config->retryAfter) + "\r\n"
+                        "Content-Type: text/html\r\n"
+                        "Content-Length: " + SSTR(body.size()) + "\r\n"
+                        "Connection: close\r\n\r\n" + body;
+}
+
+void Server::listenOn(Socket &socket, const ServerConfig &config, bool reusePort)
+{
     int opt = 1;
-    if (setsockopt(_socket.get_fd(), SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    if (setsockopt(socket.get_fd(), SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
     {
         throw std::runtime_error("Failed to set SO_REUSEADDR");
     }
+    // every worker binds its own copy of the listener, the kernel balances accepts between them
+    if (reusePort && setsockopt(socket.get_fd(), SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        throw std::runtime_error("Failed to set SO_REUSEPORT");
+    }
 
     struct sockaddr_in address;
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = inet_addr(config.host.c_str());
     address.sin_port = htons(config.port);
 
-    _socket.bind(address);
-    _socket.listen();
-    _socket.set_non_blocking();
-
-    logger.info("Server initialized on " + config.host + ":" + SSTR(config.port));
+    socket.bind(address);
+    socket.listen();
+    socket.set_non_blocking();
 }
 
 Server::~Server()
 {
+    Logger logger;
+    logger.info("Listener " + _config->host + ":" + SSTR(_config->port) + " stats: " + SSTR(_accepted) + " accepted, " +
+                SSTR(_shed) + " shed (fd limit), max " + SSTR(_maxBatch) + " per wakeup, peak accept queue " + SSTR(_peakQueue) +
+                "; connections " + SSTR(_connections->current) + " open, peak " + SSTR(_connections->peak) + ", " +
+                SSTR(_connections->shed) + " rejected, " + SSTR(_pauses) + " pauses");
+    if (_reserveFd != -1)
+        close(_reserveFd);
 }
 
 int Server::get_fd() const
@@ -55,21 +113,121 @@ void Server::onEvent(uint32_t events)
 void Server::onReadable()
 {
     Logger logger;
+    size_t batch = 0;
 
-    try
+    while (batch < _config->acceptBatch)
     {
-        int client_socket = _socket.accept();
+        bool overloaded = _connections->full() || _fd_manager.connections().full();
+        if (overloaded && !_config->overloadReject)
+        {
+            // backpressure: leave the rest in the backlog until a client goes away
+            _fd_manager.pauseListener(get_fd());
+            ++_pauses;
+            break;
+        }
+
+        int client_socket = _socket.accept(SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno == EMFILE || errno == ENFILE)
+            {
+                if (!_shedConnection())
+                {
+                    // nothing to shed with: stop polling until a descriptor is released, as over max_connections
+                    _fd_manager.pauseListener(get_fd());
+                    ++_pauses;
+                    break;
+                }
+                ++batch;
+                continue;
+            }
+            logger.error("Failed to accept client connection: " + std::string(strerror(errno)));
+            break;
+        }
+        ++batch;
+        if (overloaded)
+        {
+            _rejectOverload(client_socket);
+            continue;
+        }
+        ++_accepted;
 
         logger.info("New client connection accepted on fd: " + SSTR(client_socket));
 
-        Client *client = new Client(client_socket, _config, _fd_manager);
+        Client *client = NULL;
+        try
+        {
+            client = new Client(client_socket, _config, _fd_manager, _connections);
 
-        _fd_manager.add(client->get_fd(), client, READ_EVENT);
+            _fd_manager.add(client->get_fd(), client, _config->edgeTriggered ? READ_EVENT | EPOLLET : READ_EVENT);
+        }
+        catch (const std::exception &e)
+        {
+            logger.error("Failed to register client connection: " + std::string(e.what()));
+            // a constructed Client owns the socket, otherwise it is still ours to close
+            if (client)
+                delete client;
+            else
+                close(client_socket);
+        }
     }
-    catch (const std::exception &e)
+
+    if (batch > _maxBatch)
+        _maxBatch = batch;
+    // stopped on the batch limit, connections are probably still queued
+    if (batch == _config->acceptBatch)
+        _sampleQueue();
+}
+
+// out of descriptors: free the reserve fd, accept the pending connection and close it
+// right away so the client gets a reset instead of sitting in a full backlog.
+// false when there is no reserve fd to give up
+bool Server::_shedConnection()
+{
+    Logger logger;
+
+    // an earlier shed may have lost the reserve to another thread, try to get it back first
+    if (_reserveFd == -1)
+        _reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (_reserveFd == -1)
+        return false;
+    close(_reserveFd);
+    int fd = _socket.accept(SOCK_CLOEXEC);
+    if (fd != -1)
     {
-        logger.error("Failed to accept client connection: " + std::string(e.what()));
+        close(fd);
+        ++_shed;
+        logger.warning("Out of file descriptors, dropped a connection on " + _config->host + ":" + SSTR(_config->port));
     }
+    _reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return true;
+}
+
+// over max_connections with overload_policy reject: best-effort 503, the connection never becomes a Client.
+// The request the client already sent is read and dropped until it closes, so the 503 is not lost to an RST
+void Server::_rejectOverload(int fd)
+{
+    ::send(fd, _overloadResponse.data(), _overloadResponse.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    shutdown(fd, SHUT_WR);
+    LingeringClose::start(fd, _config, _fd_manager);
+    _connections->shed++;
+    _fd_manager.connections().shed++;
+}
+
+// for a listening socket tcpi_unacked is the current accept queue length
+void Server::_sampleQueue()
+{
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+
+    if (getsockopt(get_fd(), IPPROTO_TCP, TCP_INFO, &info, &len) == -1)
+        return;
+    if (info.tcpi_unacked > _peakQueue)
+        _peakQueue = info.tcpi_unacked;
 }
 
 void Server::onWritable()
@@ -101,3 +259,20 @@ void Server::onTimeout()
     Logger logger;
     logger.warning("Unexpected timeout event on server socket");
 }
+
+// SIGHUP reload: new clients get the new settings, running ones keep their copy
+void Server::reconfigure(const std::vector<ServerConfig> &servers)
+{
+    Logger logger;
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        if (servers[i].host != _config->host || servers[i].port != _config->port)
+            continue;
+        _config = ServerConfigPtr(new ServerConfig(servers[i]));
+        _connections->max = _config->maxConnections;
+        _buildOverloadResponse();
+        logger.info("Listener " + _config->host + ":" + SSTR(_config->port) + " reconfigured");
+        return;
+    }
+}
@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include <cstring>
 #include <stdexcept>
+#include <cerrno>
 #include "Logger.hpp"
 Socket::Socket(const Socket &other) : _fd(other._fd), _event(other._event), _epoll(other._epoll) {}
 
@@ -77,18 +78,12 @@ void Socket::listen()
     }
 }
 
-int Socket::accept()
+int Socket::accept(int flags)
 {
     struct sockaddr_in client_addr;
     socklen_t client_len = sizeof(client_addr);
 
-    int client_fd = ::accept(_fd, (struct sockaddr *)&client_addr, &client_len);
-    if (client_fd < 0)
-    {
-        throw std::runtime_error("Failed to accept connection");
-    }
-
-    return client_fd;
+    return ::accept4(_fd, (struct sockaddr *)&client_addr, &client_len, flags);
 }
 
 void Socket::connect(std::string ip, int port)
@@ -144,7 +139,7 @@ void Socket::connect(std::string ip, int port, sa_family_t family)
 ssize_t Socket::send(const char *buffer, size_t length, int flags)
 {
     ssize_t result = ::send(_fd, buffer, length, flags);
-    if (result == -1)
+    if (result == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
     {
         throw std::runtime_error("Failed to send data");
     }
@@ -154,7 +149,7 @@ ssize_t Socket::send(const char *buffer, size_t length, int flags)
 ssize_t Socket::recv(char *buffer, size_t length, int flags)
 {
     ssize_t result = ::recv(_fd, buffer, length, flags);
-    if (result == -1)
+    if (result == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
     {
         throw std::runtime_error("Failed to receive data");
     }
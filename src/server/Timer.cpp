@@ -0,0 +1,64 @@
+#include "Timer.hpp"
+#include <stdint.h>
+
+Timer::Timer() : _armedAt(-1)
+{
+    _fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (_fd == -1)
+    {
+        throw std::runtime_error("Failed to create timer file descriptor");
+    }
+}
+
+Timer::~Timer()
+{
+    if (_fd != -1)
+    {
+        close(_fd);
+    }
+}
+
+msec_t Timer::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<msec_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int Timer::getFd() const
+{
+    return _fd;
+}
+
+void Timer::arm(msec_t deadline)
+{
+    if (deadline == _armedAt)
+        return;
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 0;
+    spec.it_value.tv_sec = 0;
+    spec.it_value.tv_nsec = 0;
+    if (deadline != -1)
+    {
+        // a zero it_value would disarm, deadlines are never that close to boot anyway
+        if (deadline <= 0)
+            deadline = 1;
+        spec.it_value.tv_sec = deadline / 1000;
+        spec.it_value.tv_nsec = (deadline % 1000) * 1000000;
+    }
+    if (timerfd_settime(_fd, TFD_TIMER_ABSTIME, &spec, NULL) == -1)
+    {
+        throw std::runtime_error("Failed to arm timer");
+    }
+    _armedAt = deadline;
+}
+
+void Timer::clear()
+{
+    uint64_t expirations;
+    if (read(_fd, &expirations, sizeof(expirations)) < 0)
+        return;
+    _armedAt = -1;
+}
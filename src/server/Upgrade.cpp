@@ -0,0 +1,156 @@
+#include "Upgrade.hpp"
+#include "Logger.hpp"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+extern char **environ;
+
+std::string intToString(int value);
+
+std::string Upgrade::_binary;
+std::string Upgrade::_config;
+std::vector<int> Upgrade::_inherited;
+pid_t Upgrade::_parent = 0;
+pid_t Upgrade::_child = 0;
+
+void Upgrade::init(const char *binary, const char *config)
+{
+    // resolved now so a binary replaced on disk is the one that gets exec'd. argv[0] is only
+    // a path when we were started with one, through PATH it is a bare name
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len > 0)
+        _binary.assign(path, len);
+    else
+        _binary = realpath(binary, path) ? path : binary;
+    _config = config;
+
+    const char *fds = getenv(LISTEN_FDS_ENV);
+    const char *parent = getenv(UPGRADE_PARENT_ENV);
+    if (fds)
+    {
+        std::istringstream list(fds);
+        std::string fd;
+        while (std::getline(list, fd, ','))
+        {
+            if (!fd.empty())
+                _inherited.push_back(std::atoi(fd.c_str()));
+        }
+    }
+    if (parent)
+        _parent = std::atoi(parent);
+    // CGI children must not see these
+    unsetenv(LISTEN_FDS_ENV);
+    unsetenv(UPGRADE_PARENT_ENV);
+}
+
+int Upgrade::take(const std::string &host, int port)
+{
+    for (size_t i = 0; i < _inherited.size(); ++i)
+    {
+        struct sockaddr_in address;
+        socklen_t len = sizeof(address);
+        if (getsockname(_inherited[i], (struct sockaddr *)&address, &len) == -1 || address.sin_family != AF_INET)
+            continue;
+        if (address.sin_addr.s_addr != inet_addr(host.c_str()) || ntohs(address.sin_port) != port)
+            continue;
+
+        int fd = _inherited[i];
+        _inherited.erase(_inherited.begin() + i);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        Logger logger;
+        logger.info("Adopted inherited listener fd " + intToString(fd) + " for " + host + ":" + intToString(port));
+        return fd;
+    }
+    return -1;
+}
+
+void Upgrade::ready()
+{
+    Logger logger;
+
+    for (size_t i = 0; i < _inherited.size(); ++i)
+    {
+        logger.warning("Closing inherited listener fd " + intToString(_inherited[i]) + ", not in the config");
+        close(_inherited[i]);
+    }
+    _inherited.clear();
+
+    if (_parent && _parent == getppid())
+    {
+        logger.info("Upgrade complete, asking the old instance " + intToString(_parent) + " to drain");
+        kill(_parent, SIGTERM);
+    }
+    _parent = 0;
+}
+
+pid_t Upgrade::spawn(const std::vector<int> &listenFds)
+{
+    Logger logger;
+
+    // an earlier attempt that died is still waiting to be reaped
+    if (_child > 0 && waitpid(_child, NULL, WNOHANG) == 0)
+    {
+        logger.warning("Binary upgrade already in progress (pid " + intToString(_child) + ")");
+        return -1;
+    }
+
+    // everything exec needs is built before fork, the child only makes async-signal-safe calls
+    std::string fds;
+    for (size_t i = 0; i < listenFds.size(); ++i)
+        fds += (i ? "," : "") + intToString(listenFds[i]);
+    std::vector<std::string> env;
+    for (char **var = environ; *var; ++var)
+    {
+        if (strncmp(*var, LISTEN_FDS_ENV "=", sizeof(LISTEN_FDS_ENV)) && strncmp(*var, UPGRADE_PARENT_ENV "=", sizeof(UPGRADE_PARENT_ENV)))
+            env.push_back(*var);
+    }
+    env.push_back(std::string(LISTEN_FDS_ENV "=") + fds);
+    env.push_back(std::string(UPGRADE_PARENT_ENV "=") + intToString(getpid()));
+
+    std::vector<char *> envp;
+    for (size_t i = 0; i < env.size(); ++i)
+        envp.push_back(const_cast<char *>(env[i].c_str()));
+    envp.push_back(NULL);
+    char *argv[] = {const_cast<char *>(_binary.c_str()), const_cast<char *>(_config.c_str()), NULL};
+    long maxFd = sysconf(_SC_OPEN_MAX);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        logger.error("Binary upgrade: fork failed");
+        return -1;
+    }
+    if (pid == 0)
+    {
+        // only the listeners cross exec, every other descriptor (clients, epoll, CGI pipes) is closed
+        for (int fd = 3; fd < maxFd; ++fd)
+        {
+            bool keep = false;
+            for (size_t i = 0; i < listenFds.size() && !keep; ++i)
+                keep = listenFds[i] == fd;
+            if (keep)
+                fcntl(fd, F_SETFD, 0);
+            else
+                close(fd);
+        }
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        execve(argv[0], argv, &envp[0]);
+        _exit(127);
+    }
+    _child = pid;
+    logger.info("Binary upgrade: started " + _binary + " as pid " + intToString(pid) + " with " +
+                intToString(listenFds.size()) + " listeners");
+    return pid;
+}
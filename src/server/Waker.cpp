@@ -0,0 +1,47 @@
+#include "Waker.hpp"
+#include <cerrno>
+#include <stdint.h>
+
+Waker::Waker()
+{
+    _fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_fd == -1)
+    {
+        throw std::runtime_error("Failed to create wakeup file descriptor");
+    }
+}
+
+Waker::~Waker()
+{
+    if (_fd != -1)
+    {
+        close(_fd);
+    }
+}
+
+int Waker::getFd() const
+{
+    return _fd;
+}
+
+void Waker::wake()
+{
+    wake(_fd);
+}
+
+// called from signal handlers: keeps errno intact, and a full counter (EAGAIN) leaves the fd readable anyway
+void Waker::wake(int fd)
+{
+    int saved = errno;
+    uint64_t one = 1;
+    ssize_t ret = write(fd, &one, sizeof(one));
+    (void)ret;
+    errno = saved;
+}
+
+void Waker::clear()
+{
+    uint64_t count;
+    if (read(_fd, &count, sizeof(count)) < 0)
+        return;
+}
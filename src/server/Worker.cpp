@@ -0,0 +1,122 @@
+#include "Worker.hpp"
+#include "Upgrade.hpp"
+#include <unistd.h>
+
+extern volatile sig_atomic_t g_shutdown;
+extern volatile sig_atomic_t g_wakeFd;
+
+std::string intToString(int value);
+
+Worker::Worker(std::vector<ServerConfig> &servers, bool reusePort)
+    : _servers(servers), _reusePort(reusePort), _started(false), _done(false)
+{
+    pthread_mutex_init(&_doneLock, NULL);
+}
+
+Worker::Worker(std::vector<ServerConfig> &servers, const std::vector<int> &listenFds)
+    : _servers(servers), _listenFds(listenFds), _reusePort(false), _started(false), _done(false)
+{
+    pthread_mutex_init(&_doneLock, NULL);
+}
+
+Worker::~Worker()
+{
+    stop();
+    pthread_mutex_destroy(&_doneLock);
+}
+
+void Worker::run()
+{
+    EventLoop eventLoop(_waker);
+
+    for (size_t i = 0; i < _servers.size(); ++i)
+    {
+        ServerConfig &config = _servers[i];
+        Server *server;
+        int inherited = -1;
+        if (i < _listenFds.size())
+            server = new Server(config, eventLoop.fd_manager, _listenFds[i], fromFdTag());
+        else if (!_reusePort && (inherited = Upgrade::take(config.host, config.port)) != -1)
+            server = new Server(config, eventLoop.fd_manager, inherited, fromFdTag());
+        else
+            server = new Server(config, eventLoop.fd_manager, _reusePort);
+        eventLoop.addListener(server);
+        logger.info("Configured server: " + config.name + " on " + config.host + ":" + intToString(config.port));
+    }
+
+    // single-process mode: the only loop, it hands its listeners over on SIGUSR2
+    if (!_reusePort && _listenFds.empty())
+    {
+        eventLoop.handleUpgrades();
+        Upgrade::ready();
+    }
+
+    // the only loop of this process receives the signals itself, worker threads are woken by the main thread
+    if (!_reusePort)
+        g_wakeFd = _waker.getFd();
+    logger.info("Starting event loop");
+    eventLoop.run();
+    g_wakeFd = -1;
+    logger.info("Event loop exited");
+}
+
+void *Worker::_routine(void *arg)
+{
+    Worker *worker = static_cast<Worker *>(arg);
+
+    try
+    {
+        worker->run();
+    }
+    catch (const std::exception &e)
+    {
+        worker->logger.error(std::string("Worker failed: ") + e.what());
+        g_shutdown = 1;
+        kill(getpid(), SIGTERM); // wake the main thread, it is the only one accepting SIGTERM
+    }
+    catch (...)
+    {
+        worker->logger.error("Worker failed: unknown error");
+        g_shutdown = 1;
+        kill(getpid(), SIGTERM);
+    }
+    pthread_mutex_lock(&worker->_doneLock);
+    worker->_done = true;
+    pthread_mutex_unlock(&worker->_doneLock);
+    return NULL;
+}
+
+bool Worker::_isDone()
+{
+    pthread_mutex_lock(&_doneLock);
+    bool done = _done;
+    pthread_mutex_unlock(&_doneLock);
+    return done;
+}
+
+void Worker::start()
+{
+    if (pthread_create(&_thread, NULL, _routine, this) != 0)
+        throw std::runtime_error("Failed to create worker thread");
+    _started = true;
+}
+
+void Worker::wake()
+{
+    if (_started && !_isDone())
+        _waker.wake();
+}
+
+void Worker::stop()
+{
+    if (!_started)
+        return;
+    // keep waking the loop while it drains, so a second shutdown signal is seen right away
+    while (!_isDone())
+    {
+        _waker.wake();
+        usleep(10000);
+    }
+    pthread_join(_thread, NULL);
+    _started = false;
+}
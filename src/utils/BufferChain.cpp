@@ -0,0 +1,215 @@
+#include "BufferChain.hpp"
+#include "BufferPool.hpp"
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+
+BufferChain::BufferChain() : _size(0)
+{
+}
+
+BufferChain::BufferChain(const BufferChain &other) : _size(0)
+{
+    *this = other;
+}
+
+BufferChain &BufferChain::operator=(const BufferChain &other)
+{
+    if (this == &other)
+        return *this;
+    clear();
+    for (size_t i = 0; i < other._segments.size(); ++i)
+    {
+        const Segment &segment = other._segments[i];
+        append(segment.data + segment.start, segment.end - segment.start);
+    }
+    return *this;
+}
+
+BufferChain::~BufferChain()
+{
+    clear();
+}
+
+size_t BufferChain::size() const
+{
+    return _size;
+}
+
+bool BufferChain::empty() const
+{
+    return _size == 0;
+}
+
+BufferChain::Segment &BufferChain::_writable()
+{
+    if (_segments.empty() || _segments.back().end == CHAIN_SEGMENT)
+    {
+        Segment segment = {BufferPool::acquire(CHAIN_SEGMENT), 0, 0};
+        if (!segment.data)
+            throw std::runtime_error("I/O buffer pool exhausted (buffer_pool_size)");
+        _segments.push_back(segment);
+    }
+    return _segments.back();
+}
+
+void BufferChain::_pop()
+{
+    BufferPool::release(_segments.front().data, CHAIN_SEGMENT);
+    _segments.pop_front();
+}
+
+void BufferChain::append(const char *data, size_t size)
+{
+    while (size)
+    {
+        Segment &segment = _writable();
+        size_t room = CHAIN_SEGMENT - segment.end;
+        size_t chunk = size < room ? size : room;
+        std::memcpy(segment.data + segment.end, data, chunk);
+        segment.end += chunk;
+        _size += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+void BufferChain::append(const std::string &data)
+{
+    append(data.data(), data.size());
+}
+
+void BufferChain::splice(BufferChain &other)
+{
+    if (this == &other)
+        return;
+    _segments.insert(_segments.end(), other._segments.begin(), other._segments.end());
+    _size += other._size;
+    other._segments.clear();
+    other._size = 0;
+}
+
+size_t BufferChain::peek(char *out, size_t size) const
+{
+    size_t copied = 0;
+    for (size_t i = 0; i < _segments.size() && copied < size; ++i)
+    {
+        const Segment &segment = _segments[i];
+        size_t chunk = segment.end - segment.start;
+        if (chunk > size - copied)
+            chunk = size - copied;
+        std::memcpy(out + copied, segment.data + segment.start, chunk);
+        copied += chunk;
+    }
+    return copied;
+}
+
+size_t BufferChain::read(char *out, size_t size)
+{
+    size_t copied = peek(out, size);
+    consume(copied);
+    return copied;
+}
+
+void BufferChain::consume(size_t size)
+{
+    if (size > _size)
+        size = _size;
+    _size -= size;
+    while (size)
+    {
+        Segment &segment = _segments.front();
+        size_t chunk = segment.end - segment.start;
+        if (chunk > size)
+        {
+            segment.start += size;
+            return;
+        }
+        size -= chunk;
+        _pop();
+    }
+    // a drained chain keeps no page, the next append borrows a warm one from the pool
+    while (!_segments.empty() && _segments.front().start == _segments.front().end)
+        _pop();
+}
+
+void BufferChain::clear()
+{
+    while (!_segments.empty())
+        _pop();
+    _size = 0;
+}
+
+size_t BufferChain::exportIov(struct iovec *iov, size_t max) const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < _segments.size() && count < max; ++i)
+    {
+        const Segment &segment = _segments[i];
+        if (segment.start == segment.end)
+            continue;
+        iov[count].iov_base = segment.data + segment.start;
+        iov[count].iov_len = segment.end - segment.start;
+        count++;
+    }
+    return count;
+}
+
+ssize_t BufferChain::writeTo(int fd)
+{
+    struct iovec iov[CHAIN_IOV_MAX];
+    size_t count = exportIov(iov, CHAIN_IOV_MAX);
+    if (!count)
+        return 0;
+    ssize_t written = ::writev(fd, iov, count);
+    if (written > 0)
+        consume(written);
+    return written;
+}
+
+ssize_t BufferChain::readFrom(int fd, size_t max)
+{
+    struct iovec iov[2];
+    size_t count = 0;
+    size_t room = 0;
+
+    // the free tail of the last segment first, a fresh page only if that is too small
+    if (!_segments.empty() && _segments.back().end < CHAIN_SEGMENT)
+    {
+        Segment &last = _segments.back();
+        room = CHAIN_SEGMENT - last.end;
+        if (room > max)
+            room = max;
+        iov[count].iov_base = last.data + last.end;
+        iov[count].iov_len = room;
+        count++;
+    }
+    Segment fresh = {NULL, 0, 0};
+    if (room < max)
+    {
+        if (!(fresh.data = BufferPool::acquire(CHAIN_SEGMENT)))
+            throw std::runtime_error("I/O buffer pool exhausted (buffer_pool_size)");
+        iov[count].iov_base = fresh.data;
+        iov[count].iov_len = max - room < CHAIN_SEGMENT ? max - room : CHAIN_SEGMENT;
+        count++;
+    }
+
+    ssize_t n = ::readv(fd, iov, count);
+    size_t filled = n > 0 ? n : 0;
+    size_t tail = filled < room ? filled : room;
+    if (tail)
+    {
+        _segments.back().end += tail;
+        _size += tail;
+        filled -= tail;
+    }
+    if (filled)
+    {
+        fresh.end = filled;
+        _segments.push_back(fresh);
+        _size += filled;
+    }
+    else if (fresh.data)
+        BufferPool::release(fresh.data, CHAIN_SEGMENT);
+    return n;
+}
@@ -0,0 +1,128 @@
+#include "BufferPool.hpp"
+#include "Logger.hpp"
+#include <cstdlib>
+
+std::string intToString(int value);
+
+std::vector<char *> BufferPool::_free[POOL_CLASSES];
+PoolStats BufferPool::_stats = {0, 0, 0, 0, 0, 0, 0};
+pthread_mutex_t BufferPool::_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void BufferPool::setBudget(size_t bytes)
+{
+    _stats.budget = bytes;
+}
+
+int BufferPool::_class(size_t size)
+{
+    size_t page = POOL_MIN_PAGE;
+    for (int i = 0; i < POOL_CLASSES; ++i, page *= 2)
+    {
+        if (size <= page)
+            return i;
+    }
+    return -1;
+}
+
+size_t BufferPool::pageSize(size_t size)
+{
+    int index = _class(size);
+    return index == -1 ? size : static_cast<size_t>(POOL_MIN_PAGE) << index;
+}
+
+// makes room for a new page of size bytes, dropping cached pages of other classes if needed
+bool BufferPool::_reserve(size_t size)
+{
+    if (!_stats.budget || _stats.allocated + size <= _stats.budget)
+        return true;
+    for (int i = POOL_CLASSES - 1; i >= 0; --i)
+    {
+        size_t page = static_cast<size_t>(POOL_MIN_PAGE) << i;
+        while (!_free[i].empty() && _stats.allocated + size > _stats.budget)
+        {
+            std::free(_free[i].back());
+            _free[i].pop_back();
+            _stats.allocated -= page;
+        }
+    }
+    return _stats.allocated + size <= _stats.budget;
+}
+
+char *BufferPool::acquire(size_t size)
+{
+    int index = _class(size);
+    size = pageSize(size);
+    char *page = NULL;
+
+    pthread_mutex_lock(&_lock);
+    _stats.borrows++;
+    if (index != -1 && !_free[index].empty())
+    {
+        page = _free[index].back();
+        _free[index].pop_back();
+        _stats.reused++;
+    }
+    else if (_reserve(size) && (page = static_cast<char *>(std::malloc(size))))
+        _stats.allocated += size;
+    else
+        _stats.failures++;
+
+    if (page)
+    {
+        _stats.inUse += size;
+        if (_stats.inUse > _stats.highWater)
+            _stats.highWater = _stats.inUse;
+    }
+    pthread_mutex_unlock(&_lock);
+    return page;
+}
+
+void BufferPool::release(char *page, size_t size)
+{
+    if (!page)
+        return;
+    int index = _class(size);
+    size = pageSize(size);
+
+    pthread_mutex_lock(&_lock);
+    _stats.inUse -= size;
+    if (index == -1)
+    {
+        std::free(page);
+        _stats.allocated -= size;
+    }
+    else
+        _free[index].push_back(page);
+    pthread_mutex_unlock(&_lock);
+}
+
+void BufferPool::trim()
+{
+    pthread_mutex_lock(&_lock);
+    for (int i = 0; i < POOL_CLASSES; ++i)
+    {
+        for (size_t j = 0; j < _free[i].size(); ++j)
+            std::free(_free[i][j]);
+        _stats.allocated -= _free[i].size() * (static_cast<size_t>(POOL_MIN_PAGE) << i);
+        _free[i].clear();
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+PoolStats BufferPool::stats()
+{
+    pthread_mutex_lock(&_lock);
+    PoolStats copy = _stats;
+    pthread_mutex_unlock(&_lock);
+    return copy;
+}
+
+void BufferPool::logStats()
+{
+    PoolStats s = stats();
+    Logger logger;
+    logger.info("Buffer pool stats: " + intToString(s.highWater / 1024) + " KB high water, " +
+                intToString(s.allocated / 1024) + " KB held, " + intToString(s.borrows) + " borrows (" +
+                intToString(s.reused) + " reused), " + intToString(s.failures) + " refused, budget " +
+                (s.budget ? intToString(s.budget / 1024) + " KB" : std::string("unlimited")));
+}
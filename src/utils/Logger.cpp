@@ -24,13 +24,13 @@ Logger::~Logger()
 std::string Logger::_currentTimestamp(void) const
 {
     time_t rawtime;
-    struct tm *timeinfo;
+    struct tm timeinfo;
 
     time(&rawtime);
-    timeinfo = localtime(&rawtime);
+    localtime_r(&rawtime, &timeinfo); // reentrant, loggers may run on several worker threads
 
     char buff[32] = {0};
-    size_t bytes = strftime(buff, sizeof(buff), "[%H:%M:%S %d-%m-%Y]", timeinfo);
+    size_t bytes = strftime(buff, sizeof(buff), "[%H:%M:%S %d-%m-%Y]", &timeinfo);
 
     if (bytes == 0)
         return "[TIMESTAMP_ERROR]";
@@ -0,0 +1,17 @@
+#!/usr/bin/env python3
+"""
+CGI script that writes 50 MB of output before it reads its stdin, so the
+server sends the response while the request body is still arriving
+"""
+import sys
+
+sys.stdout.write("Content-Type: text/plain\r\n")
+sys.stdout.write("\r\n")
+sys.stdout.flush()
+
+line = b"x" * 1023 + b"\n"
+for _ in range(50 * 1024):
+    sys.stdout.buffer.write(line)
+sys.stdout.buffer.flush()
+
+sys.stdin.buffer.read()
@@ -0,0 +1,64 @@
+// regression check: a client that half-closes while a CGI response is streaming.
+// The connection is polled for reads and writes at once, so the EOF and the
+// EPOLLOUT arrive in one event; the server must survive closing it on the first half.
+// usage: make bench && ./webserv configs/default.conf & ./tools/cgi_halfclose [port]
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static int connectTo(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    struct timeval tv = {5, 0};
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        std::perror("connect");
+        std::exit(2);
+    }
+    return fd;
+}
+
+int main(int ac, char **av)
+{
+    int port = ac > 1 ? std::atoi(av[1]) : 8080;
+    char buf[65536];
+
+    // the body stays incomplete, so the request is still being read when the script floods its output
+    int fd = connectTo(port);
+    std::string req = "POST /cgi/flood HTTP/1.1\r\nHost: localhost\r\nContent-Length: 4096\r\n\r\n";
+    req.append(16, 'a');
+    send(fd, req.data(), req.size(), 0);
+    usleep(300 * 1000);
+    shutdown(fd, SHUT_WR);
+
+    size_t received = 0;
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+        received += n;
+    close(fd);
+
+    // the worker is still serving if a fresh connection gets an answer
+    fd = connectTo(port);
+    req = "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    send(fd, req.data(), req.size(), 0);
+    n = recv(fd, buf, sizeof(buf) - 1, 0);
+    close(fd);
+
+    bool alive = n > 0 && std::strncmp(buf, "HTTP/1.1 ", 9) == 0;
+    std::printf("%lu bytes before the close, server %s\n", static_cast<unsigned long>(received),
+                alive ? "still answering: PASS" : "gone: FAIL");
+    return alive ? 0 : 1;
+}
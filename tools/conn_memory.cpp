@@ -0,0 +1,102 @@
+// resident memory a running server spends per open connection.
+// usage: make bench && ./tools/conn_memory PID [connections] [port]
+// Opens the connections in two rounds, fresh (nothing sent yet) and idle keep-alive
+// (one request answered), and reports the growth of the server's VmRSS.
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static long rssKb(int pid)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    std::ifstream status(path);
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            return std::atol(line.c_str() + 6);
+    }
+    return -1;
+}
+
+static int connectTo(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    address.sin_port = htons(port);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+    {
+        std::perror("connect");
+        std::exit(1);
+    }
+    return fd;
+}
+
+// sends a keep-alive GET and reads until the end of the (Content-Length) response
+static void request(int fd)
+{
+    const char req[] = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    if (send(fd, req, sizeof(req) - 1, 0) == -1)
+        return;
+    std::string got;
+    char buf[16384];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+    {
+        got.append(buf, n);
+        size_t head = got.find("\r\n\r\n");
+        size_t length = got.find("Content-Length: ");
+        if (head != std::string::npos && length != std::string::npos &&
+            got.size() >= head + 4 + std::strtoul(got.c_str() + length + 16, NULL, 10))
+            return;
+    }
+}
+
+static void round(int pid, int port, size_t count, bool keepAlive)
+{
+    std::vector<int> fds;
+    usleep(300000);
+    long before = rssKb(pid);
+    for (size_t i = 0; i < count; ++i)
+    {
+        fds.push_back(connectTo(port));
+        if (keepAlive)
+            request(fds.back());
+    }
+    usleep(500000);
+    long after = rssKb(pid);
+    std::printf("%-22s %6lu connections: VmRSS %ld -> %ld KB, %.2f KB per connection\n",
+                keepAlive ? "idle after a request" : "fresh", static_cast<unsigned long>(count), before, after,
+                static_cast<double>(after - before) / count);
+    for (size_t i = 0; i < fds.size(); ++i)
+        close(fds[i]);
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2)
+    {
+        std::fprintf(stderr, "usage: %s PID [connections] [port]\n", av[0]);
+        return 1;
+    }
+    int pid = std::atoi(av[1]);
+    size_t count = ac > 2 ? std::strtoul(av[2], NULL, 10) : 1000;
+    int port = ac > 3 ? std::atoi(av[3]) : 8080;
+
+    // the first round also grows the server's tables and pools, run it once before measuring
+    round(pid, port, count, true);
+    round(pid, port, count, false);
+    round(pid, port, count, true);
+    return 0;
+}
@@ -0,0 +1,139 @@
+// FdManager lookup and dispatch cost: the fd-indexed slot table against the std::map it replaced.
+// usage: make bench && ./tools/fdmanager_bench [events]
+#include "FdManager.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <time.h>
+
+#define BATCH (1 << 20) // events replayed in a cycle, spread over every registered fd
+
+// registers fds without touching the kernel, keeps the generations the loop would see in events
+class NullPoller : public Poller
+{
+public:
+    std::vector<uint32_t> generations;
+
+    void add_fd(int fd, uint32_t, uint32_t generation)
+    {
+        if (static_cast<size_t>(fd) >= generations.size())
+            generations.resize(fd + 1);
+        generations[fd] = generation;
+    }
+    void modify_fd(int, uint32_t, uint32_t) {}
+    void remove_fd(int) {}
+    EventSpan wait(int) { EventSpan span = {NULL, NULL}; return span; }
+    const char *name() const { return "null"; }
+};
+
+class NullHandler : public EventHandler
+{
+private:
+    int _fd;
+
+public:
+    size_t events;
+
+    NullHandler(FdManager &fdm, int fd) : EventHandler(ServerConfigPtr(), fdm, -1), _fd(fd), events(0) {}
+    void onEvent(uint32_t) { ++events; }
+    int get_fd() { return _fd; }
+};
+
+static double nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void run(size_t fds, size_t count)
+{
+    NullPoller poller;
+    FdManager manager(poller);
+    std::map<int, EventHandler *> map;
+    std::vector<NullHandler *> handlers;
+    // real fds start after stdio, the listener and the loop's timerfd/eventfd
+    const int first = 8;
+
+    for (size_t i = 0; i < fds; ++i)
+    {
+        int fd = first + i;
+        handlers.push_back(new NullHandler(manager, fd));
+        manager.add(fd, handlers.back(), EPOLLIN, false);
+        map[fd] = handlers.back();
+    }
+
+    // the loop sees events in no particular fd order
+    std::vector<epoll_event> batch(BATCH);
+    srand(42);
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        int fd = first + rand() % fds;
+        batch[i].events = EPOLLIN;
+        batch[i].data.u64 = EVENT_DATA(fd, poller.generations[fd]);
+    }
+
+    size_t hits = 0;
+    double start = nowNs();
+    for (size_t i = 0; i < count; ++i)
+        hits += manager.getOwner(EVENT_FD(batch[i % BATCH]), EVENT_GEN(batch[i % BATCH])) != NULL;
+    double slotNs = (nowNs() - start) / count;
+
+    start = nowNs();
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::map<int, EventHandler *>::iterator it = map.find(EVENT_FD(batch[i % BATCH]));
+        hits += it != map.end() && it->second != NULL;
+    }
+    double mapNs = (nowNs() - start) / count;
+
+    // what EventLoop::run does per event: owner by fd and generation, then the handler's virtual onEvent
+    start = nowNs();
+    for (size_t i = 0; i < count; ++i)
+    {
+        epoll_event *event = &batch[i % BATCH];
+        EventHandler *handler = manager.getOwner(EVENT_FD(*event), EVENT_GEN(*event));
+        if (handler)
+            handler->onEvent(event->events);
+    }
+    double slotDispatchNs = (nowNs() - start) / count;
+
+    start = nowNs();
+    for (size_t i = 0; i < count; ++i)
+    {
+        epoll_event *event = &batch[i % BATCH];
+        std::map<int, EventHandler *>::iterator it = map.find(EVENT_FD(*event));
+        if (it != map.end() && it->second)
+            it->second->onEvent(event->events);
+    }
+    double mapDispatchNs = (nowNs() - start) / count;
+
+    size_t dispatched = 0;
+    for (size_t i = 0; i < handlers.size(); ++i)
+        dispatched += handlers[i]->events;
+
+    std::printf("%7lu fds: lookup   slots %6.1f ns, std::map %6.1f ns (%.1fx)\n",
+                static_cast<unsigned long>(fds), slotNs, mapNs, mapNs / slotNs);
+    std::printf("%7s      dispatch slots %6.1f ns, std::map %6.1f ns (%.1fx)%s\n", "",
+                slotDispatchNs, mapDispatchNs, mapDispatchNs / slotDispatchNs,
+                hits == 2 * count && dispatched == 2 * count ? "" : " MISMATCH");
+
+    for (size_t i = 0; i < fds; ++i)
+        manager.detachFd(first + i);
+    for (size_t i = 0; i < handlers.size(); ++i)
+        delete handlers[i];
+}
+
+int main(int ac, char **av)
+{
+    size_t count = ac > 1 ? std::strtoul(av[1], NULL, 10) : 10000000;
+    const size_t sizes[] = {1000, 10000, 100000};
+
+    std::cout.setstate(std::ios::badbit); // the Logger's debug lines, results go through stdio
+
+    std::printf("per event, %lu events in random fd order\n", static_cast<unsigned long>(count));
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+        run(sizes[i], count);
+    return 0;
+}